@@ -0,0 +1,343 @@
+// End-to-end benchmark: builds each reference scene with a fixed seed, renders
+// it at every requested thread count and reports stage times and ray rates as
+// JSON. Images are deterministic, so runs of different builds are comparable.
+
+#include "../Vector3Float.h"
+#include "../CpuFeatures.h"
+#include "../Objects/BVH.h"
+#include "../Output/ImageWriter.h"
+#include "../Render/Denoiser.h"
+#include "../Render/FrameBuffer.h"
+#include "../Render/Renderer.h"
+#include "../Render/RenderSettings.h"
+#include "../Scenes/SphereField.h"
+#include "../ThreadPool/CpuTopology.h"
+#include "../ThreadPool/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct BenchmarkOptions
+    {
+        RenderSettings render;
+        std::vector<std::string> scenes = { "random", "dense", "glass" };
+        std::vector<uint32_t> thread_counts;   // Empty: 1, 2, 4, ... up to the hardware thread count
+        int repeat = 3;                        // Renders per thread count; the fastest is reported
+        uint64_t seed = 0;
+        const char* json_name = nullptr;       // nullptr writes to stdout
+    };
+
+    struct RunResult
+    {
+        uint32_t threads;
+        double render_ms;
+        double denoise_ms;     // 0 unless denoising
+        double output_ms;
+        uint64_t primary_rays;
+        uint64_t total_rays;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double Milliseconds(Clock::time_point begin, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - begin).count();
+    }
+
+    void PrintBenchmarkUsage(const char* program)
+    {
+        std::cerr << "Usage: " << program << " [options]\n"
+            << "  --width N        image width (default 640)\n"
+            << "  --height N       image height (default 360)\n"
+            << "  --spp N          samples per pixel (default 16)\n"
+            << "  --depth N        max bounce depth (default 30)\n"
+            << "  --roulette N     Russian roulette after N bounces (default off)\n"
+            << "  --scenes LIST    comma-separated subset of random,dense,glass,instanced\n"
+            << "                   (default random,dense,glass)\n"
+            << "  --threads LIST   comma-separated thread counts (default 1, 2, 4, ... up to all cores)\n"
+            << "  --repeat N       renders per thread count, fastest is reported (default 3)\n"
+            << "  --seed N         scene seed (default 0)\n"
+            << "  --integrator recursive|wavefront\n"
+            << "  --packets on|off\n"
+            << "  --denoise on|off time the denoiser between render and output (default off)\n"
+            << "  --pin on|off     pin each worker to a CPU, one NUMA node after another (default off)\n"
+            << "  --numa on|off    per-worker tile blocks with first-touch frame placement; pins\n"
+            << "  --image FILE     where the output stage writes (default benchmark.ppm)\n"
+            << "  --json FILE      results file (default stdout)\n";
+    }
+
+    std::vector<std::string> Split(const char* list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            if (!item.empty())
+            {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    bool ParseBenchmarkArguments(int argc, char** argv, BenchmarkOptions& options)
+    {
+        RenderSettings& render = options.render;
+        render.image_width = 640;
+        render.image_height = 360;
+        render.samples_per_pixel = 16;
+        render.image_name = "benchmark.ppm";
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const char* arg = argv[i];
+            const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (!value)
+            {
+                return false;
+            }
+            ++i;
+
+            if (std::strcmp(arg, "--width") == 0) render.image_width = std::atoi(value);
+            else if (std::strcmp(arg, "--height") == 0) render.image_height = std::atoi(value);
+            else if (std::strcmp(arg, "--spp") == 0) render.samples_per_pixel = std::atoi(value);
+            else if (std::strcmp(arg, "--depth") == 0) render.max_depth = std::atoi(value);
+            else if (std::strcmp(arg, "--roulette") == 0)
+            {
+                render.roulette_min_depth = std::atoi(value);
+                render.russian_roulette = true;
+            }
+            else if (std::strcmp(arg, "--repeat") == 0) options.repeat = std::atoi(value);
+            else if (std::strcmp(arg, "--seed") == 0) options.seed = std::strtoull(value, nullptr, 10);
+            else if (std::strcmp(arg, "--image") == 0) render.image_name = value;
+            else if (std::strcmp(arg, "--json") == 0) options.json_name = value;
+            else if (std::strcmp(arg, "--scenes") == 0) options.scenes = Split(value);
+            else if (std::strcmp(arg, "--threads") == 0)
+            {
+                options.thread_counts.clear();
+                for (const std::string& item : Split(value))
+                {
+                    const int count = std::atoi(item.c_str());
+                    if (count < 1) return false;
+                    options.thread_counts.push_back(static_cast<uint32_t>(count));
+                }
+            }
+            else if (std::strcmp(arg, "--integrator") == 0)
+            {
+                if (std::strcmp(value, "recursive") == 0) render.integrator = IntegratorType::Recursive;
+                else if (std::strcmp(value, "wavefront") == 0) render.integrator = IntegratorType::Wavefront;
+                else return false;
+            }
+            else if (std::strcmp(arg, "--packets") == 0)
+            {
+                if (std::strcmp(value, "on") == 0) render.packet_tracing = true;
+                else if (std::strcmp(value, "off") == 0) render.packet_tracing = false;
+                else return false;
+            }
+            else if (std::strcmp(arg, "--denoise") == 0)
+            {
+                if (std::strcmp(value, "on") == 0) render.denoise = true;
+                else if (std::strcmp(value, "off") == 0) render.denoise = false;
+                else return false;
+            }
+            else if (std::strcmp(arg, "--pin") == 0)
+            {
+                if (std::strcmp(value, "on") == 0) render.pin_threads = true;
+                else if (std::strcmp(value, "off") == 0) render.pin_threads = false;
+                else return false;
+            }
+            else if (std::strcmp(arg, "--numa") == 0)
+            {
+                if (std::strcmp(value, "on") == 0) render.numa_placement = true;
+                else if (std::strcmp(value, "off") == 0) render.numa_placement = false;
+                else return false;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        if (options.thread_counts.empty())
+        {
+            const uint32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+            for (uint32_t count = 1; count < hardware_threads; count *= 2)
+            {
+                options.thread_counts.push_back(count);
+            }
+            options.thread_counts.push_back(hardware_threads);
+        }
+
+        return render.image_width > 0 && render.image_height > 0 && render.samples_per_pixel > 0
+            && render.max_depth > 0 && options.repeat > 0 && !options.scenes.empty();
+    }
+
+    // Keeps the fastest render of the repeats; false if an image could not be written
+    bool Run(const BenchmarkOptions& options, const Scene& scene, const Camera& camera, const Hittable& world, uint32_t thread_count, RunResult& best)
+    {
+        best = { thread_count, 0.0, 0.0, 0.0, 0, 0 };
+
+        std::vector<uint32_t> cpus;
+        std::string error;
+        if (options.render.pin_threads || options.render.numa_placement)
+        {
+            PlaceWorkers(GetCpuTopology(), {}, thread_count, cpus, error);
+        }
+
+        ThreadPool threads;
+        threads.Start(thread_count, cpus);
+        const std::vector<Tile> tiles = MakeTiles(options.render.image_width, options.render.image_height, options.render.tile_size);
+        for (int r = 0; r < options.repeat; ++r)
+        {
+            FrameBuffer frame(options.render.image_width, options.render.image_height, options.render.denoise, options.render.denoise, !options.render.numa_placement);
+            Renderer renderer(options.render, camera, scene, world, frame);
+            if (options.render.numa_placement)
+            {
+                renderer.FirstTouch(threads, tiles);
+            }
+
+            const Clock::time_point render_begin = Clock::now();
+            renderer.RenderTiles(threads, tiles);
+            const Clock::time_point render_end = Clock::now();
+            if (options.render.denoise)
+            {
+                Denoise(frame, threads);
+            }
+            const Clock::time_point denoise_end = Clock::now();
+            const bool written = MakeImageWriter(options.render.image_format)->Write(frame, threads, options.render.image_name);
+            const Clock::time_point output_end = Clock::now();
+            if (!written)
+            {
+                threads.Stop();
+                std::cerr << "Could not write " << options.render.image_name << std::endl;
+                return false;
+            }
+
+            const double render_ms = Milliseconds(render_begin, render_end);
+            if (r == 0 || render_ms < best.render_ms)
+            {
+                best.render_ms = render_ms;
+                best.denoise_ms = Milliseconds(render_end, denoise_end);
+                best.output_ms = Milliseconds(denoise_end, output_end);
+                best.primary_rays = frame.GetTotalSamples();
+                best.total_rays = renderer.GetRayCount();
+            }
+        }
+        threads.Stop();
+
+        return true;
+    }
+
+    double Mrays_per_second(uint64_t rays, double ms)
+    {
+        return ms > 0.0 ? rays / (ms * 1000.0) : 0.0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!ParseBenchmarkArguments(argc, argv, options))
+    {
+        PrintBenchmarkUsage(argv[0]);
+        return 1;
+    }
+
+    const RenderSettings& render = options.render;
+
+    std::ostringstream json;
+    json << "{\n"
+        << "  \"settings\": {\"width\": " << render.image_width << ", \"height\": " << render.image_height
+        << ", \"spp\": " << render.samples_per_pixel << ", \"max_depth\": " << render.max_depth
+        << ", \"integrator\": \"" << (render.integrator == IntegratorType::Wavefront ? "wavefront" : "recursive") << "\""
+        << ", \"packets\": " << (render.packet_tracing ? "true" : "false")
+        << ", \"denoise\": " << (render.denoise ? "true" : "false")
+        << ", \"pinned\": " << (render.pin_threads || render.numa_placement ? "true" : "false")
+        << ", \"numa\": " << (render.numa_placement ? "true" : "false")
+        << ", \"simd\": \"" << GetSimdLevelName(ActiveSimdLevel()) << "\""
+        << ", \"seed\": " << options.seed << ", \"repeat\": " << options.repeat << "},\n"
+        << "  \"scenes\": [";
+
+    for (size_t s = 0; s < options.scenes.size(); ++s)
+    {
+        const std::string& name = options.scenes[s];
+        std::cerr << "Scene " << name << std::endl;
+
+        const Clock::time_point build_begin = Clock::now();
+        const Scene* scene = Make_scene(name.c_str(), options.seed);
+        if (!scene)
+        {
+            std::cerr << "Unknown scene " << name << std::endl;
+            return 1;
+        }
+        const Clock::time_point bvh_begin = Clock::now();
+        const BVH world(scene->objects);
+        const Clock::time_point build_end = Clock::now();
+        const Camera camera = scene->CreateCamera(render.GetAspectRatio());
+
+        json << (s == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << name << "\", \"materials\": " << scene->materials.GetSize()
+            << ", \"bvh_nodes\": " << world.GetNodeCount()
+            << ", \"scene_build_ms\": " << Milliseconds(build_begin, bvh_begin)
+            << ", \"bvh_build_ms\": " << Milliseconds(bvh_begin, build_end) << ",\n"
+            << "     \"runs\": [";
+
+        double baseline_ms = 0.0;
+        for (size_t t = 0; t < options.thread_counts.size(); ++t)
+        {
+            RunResult run;
+            if (!Run(options, *scene, camera, world, options.thread_counts[t], run))
+            {
+                delete scene;
+                return 1;
+            }
+            if (t == 0)
+            {
+                baseline_ms = run.render_ms;
+            }
+            std::cerr << "  " << run.threads << " threads: " << run.render_ms << " ms, "
+                << Mrays_per_second(run.total_rays, run.render_ms) << " Mrays/s" << std::endl;
+
+            json << (t == 0 ? "\n" : ",\n")
+                << "       {\"threads\": " << run.threads
+                << ", \"render_ms\": " << run.render_ms << ", \"denoise_ms\": " << run.denoise_ms << ", \"output_ms\": " << run.output_ms
+                << ", \"primary_rays\": " << run.primary_rays << ", \"total_rays\": " << run.total_rays
+                << ", \"primary_mrays_per_s\": " << Mrays_per_second(run.primary_rays, run.render_ms)
+                << ", \"total_mrays_per_s\": " << Mrays_per_second(run.total_rays, run.render_ms)
+                << ", \"speedup\": " << (run.render_ms > 0.0 ? baseline_ms / run.render_ms : 0.0) << "}";
+        }
+        json << "\n     ]}";
+
+        delete scene;
+    }
+    json << "\n  ]\n}\n";
+
+    if (options.json_name)
+    {
+        std::ofstream file(options.json_name);
+        file << json.str();
+        if (!file)
+        {
+            std::cerr << "Could not write " << options.json_name << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << json.str();
+    }
+
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include "Utils.h"
 #include "Vector3Float.h"
 #include "Ray.h"
+#include "RayPacket.h"
 
 class Camera
 {
@@ -32,6 +33,21 @@ public:
         return Ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset);
     }
 
+    // Fills the active lanes of a packet. Each lane draws its lens sample from
+    // its own random stream, so a lane matches the ray GetRay would give it.
+    void GetRayPacket(const float* s, const float* t, uint32_t active, Pcg32* lane_rng, RayPacket& packet) const
+    {
+        for (int lane = 0; lane < RayPacket::size; ++lane)
+        {
+            if (active & (1u << lane))
+            {
+                thread_rng = lane_rng[lane];
+                packet.SetRay(lane, GetRay(s[lane], t[lane]));
+                lane_rng[lane] = thread_rng;
+            }
+        }
+    }
+
 private:
     Vector3 origin;
     Vector3 lower_left_corner;
@@ -0,0 +1,140 @@
+#pragma once
+
+// Hot-path counters for tuning depth limits and acceleration settings. Build
+// with RT_STATS defined to enable them; without it RT_COUNT expands to nothing
+// and none of this is compiled into the kernels.
+
+#include "Materials/Material.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#if defined(RT_STATS)
+    #define RT_COUNT(statement) do { statement; } while (0)
+#else
+    #define RT_COUNT(statement) do { } while (0)
+#endif
+
+// One thread's counts. Padded to whole cache lines so threads never share one.
+struct alignas(64) Counters
+{
+    static constexpr int tracked_depths = 64;   // Deeper bounces are counted in the last slot
+    static constexpr int material_types = static_cast<int>(MaterialType::Custom) + 1;
+
+    uint64_t rays_per_depth[tracked_depths] = {};   // Index 0 is the camera ray
+    uint64_t bvh_nodes_visited = 0;
+    uint64_t primitive_tests = 0;
+    uint64_t primitive_hits = 0;
+    uint64_t scatters[material_types] = {};
+    uint64_t absorptions[material_types] = {};
+    uint64_t depth_terminations = 0;                // Paths still alive at max_depth
+    uint64_t roulette_terminations = 0;             // Paths ended by Russian roulette
+
+    void AddRays(int bounce, uint64_t count = 1)
+    {
+        rays_per_depth[bounce < tracked_depths ? bounce : tracked_depths - 1] += count;
+    }
+
+    void AddScatter(MaterialType type, bool scattered)
+    {
+        ++(scattered ? scatters : absorptions)[static_cast<int>(type)];
+    }
+
+    void Merge(const Counters& other);
+
+    void Print(std::ostream& out) const;
+
+    // The calling thread's counters. Each thread writes only its own, without atomics.
+    static Counters& Local()
+    {
+        thread_local Counters* local = Register();
+        return *local;
+    }
+
+    // Sum over every thread that has counted anything. Only meaningful while no
+    // thread is counting, e.g. after a frame has finished.
+    static Counters Collect()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        Counters total;
+        for (const auto& counters : registry)
+        {
+            total.Merge(*counters);
+        }
+        return total;
+    }
+
+private:
+    static Counters* Register()
+    {
+        // Owned by the registry so the counts outlive pool threads that exit before the report
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(std::make_unique<Counters>());
+        return registry.back().get();
+    }
+
+    inline static std::mutex registry_mutex;
+    inline static std::vector<std::unique_ptr<Counters>> registry;
+};
+
+inline void Counters::Merge(const Counters& other)
+{
+    for (int d = 0; d < tracked_depths; ++d)
+    {
+        rays_per_depth[d] += other.rays_per_depth[d];
+    }
+    bvh_nodes_visited += other.bvh_nodes_visited;
+    primitive_tests += other.primitive_tests;
+    primitive_hits += other.primitive_hits;
+    for (int m = 0; m < material_types; ++m)
+    {
+        scatters[m] += other.scatters[m];
+        absorptions[m] += other.absorptions[m];
+    }
+    depth_terminations += other.depth_terminations;
+    roulette_terminations += other.roulette_terminations;
+}
+
+inline void Counters::Print(std::ostream& out) const
+{
+    static const char* const material_names[material_types] = { "Lambertian", "Metal", "Dielectric", "Custom" };
+
+    uint64_t rays = 0;
+    for (const uint64_t count : rays_per_depth)
+    {
+        rays += count;
+    }
+    const auto per_ray = [rays](uint64_t count) { return rays > 0 ? static_cast<double>(count) / rays : 0.0; };
+
+    out << "Rays traced:          " << rays << '\n'
+        << "BVH nodes visited:    " << bvh_nodes_visited << " (" << per_ray(bvh_nodes_visited) << " per ray)\n"
+        << "Primitive tests:      " << primitive_tests << " (" << per_ray(primitive_tests) << " per ray)\n"
+        << "Primitive hits:       " << primitive_hits << '\n'
+        << "Stopped at max depth: " << depth_terminations << '\n'
+        << "Ended by roulette:    " << roulette_terminations << '\n'
+        << "Rays per depth:\n";
+
+    int last_depth = tracked_depths - 1;
+    while (last_depth > 0 && rays_per_depth[last_depth] == 0)
+    {
+        --last_depth;
+    }
+    for (int d = 0; d <= last_depth; ++d)
+    {
+        out << "  " << d << (d == tracked_depths - 1 ? "+" : "") << ": " << rays_per_depth[d] << '\n';
+    }
+
+    out << "Material        scatters  absorptions\n";
+    for (int m = 0; m < material_types; ++m)
+    {
+        if (scatters[m] + absorptions[m] != 0)
+        {
+            out << "  " << std::left << std::setw(12) << material_names[m] << std::right
+                << std::setw(10) << scatters[m] << std::setw(13) << absorptions[m] << '\n';
+        }
+    }
+}
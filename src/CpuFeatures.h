@@ -0,0 +1,95 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    #define RT_X86 1
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    #define RT_TARGET(features)
+#else
+    // GCC and Clang only emit AVX instructions inside functions that ask for them
+    #define RT_TARGET(features) __attribute__((target(features)))
+#endif
+
+enum class SimdLevel
+{
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+inline SimdLevel DetectSimdLevel()
+{
+#if !defined(RT_X86)
+    return SimdLevel::Scalar;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7)
+    {
+        return SimdLevel::Scalar;
+    }
+
+    __cpuid(regs, 1);
+    const bool fma = (regs[2] & (1 << 12)) != 0;
+    const bool os_xsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!fma || !os_xsave || !avx)
+    {
+        return SimdLevel::Scalar;
+    }
+
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(regs, 7, 0);
+    const bool avx2 = (regs[1] & (1 << 5)) != 0;
+    const bool avx512f = (regs[1] & (1 << 16)) != 0;
+
+    if (avx512f && (xcr0 & 0xE6) == 0xE6)
+    {
+        return SimdLevel::AVX512;
+    }
+    if (avx2 && (xcr0 & 0x6) == 0x6)
+    {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::Scalar;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::Scalar;
+#endif
+}
+
+// Widest kernels the renderer may use. Starts at what the CPU supports and can
+// only be lowered, which is how scalar and SIMD paths are compared.
+inline SimdLevel& ActiveSimdLevel()
+{
+    static SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+inline void LimitSimdLevel(SimdLevel max_level)
+{
+    if (max_level < ActiveSimdLevel())
+    {
+        ActiveSimdLevel() = max_level;
+    }
+}
+
+inline const char* GetSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX512: return "avx512";
+    case SimdLevel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
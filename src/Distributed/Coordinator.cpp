@@ -0,0 +1,225 @@
+#include "Coordinator.h"
+#include "Protocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Ranges per worker the frame is cut into: enough for hosts of different
+    // speeds to even out, few enough that round trips stay cheap
+    constexpr int ranges_per_worker = 8;
+
+    struct WorkerAddress
+    {
+        std::string host;
+        uint16_t port;
+
+        std::string GetName() const
+        {
+            return host + ":" + std::to_string(port);
+        }
+    };
+
+    bool ParseWorkerAddresses(const char* list, std::vector<WorkerAddress>& addresses, std::string& error)
+    {
+        const std::string text = list;
+        size_t begin = 0;
+        while (begin <= text.size())
+        {
+            const size_t end = std::min(text.find(',', begin), text.size());
+            const std::string entry = text.substr(begin, end - begin);
+            const size_t colon = entry.rfind(':');
+            const int port = colon == std::string::npos ? 0 : std::atoi(entry.c_str() + colon + 1);
+            if (colon == 0 || port <= 0 || port > 65535)
+            {
+                error = "malformed worker address '" + entry + "', expected host:port";
+                return false;
+            }
+            addresses.push_back({ entry.substr(0, colon), static_cast<uint16_t>(port) });
+            begin = end + 1;
+        }
+        return true;
+    }
+
+    // Tile ranges not yet handed out, shared by the worker threads
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<TileRange> pending;
+        int in_flight = 0;      // Ranges handed out and not yet merged
+        int tiles_left = 0;
+        int live_workers = 0;
+
+        // Waits while other workers still hold ranges that may come back.
+        // Returns false once every tile is merged.
+        bool Take(TileRange& range)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return !pending.empty() || in_flight == 0; });
+            if (pending.empty())
+            {
+                return false;
+            }
+            range = pending.front();
+            pending.pop_front();
+            ++in_flight;
+            return true;
+        }
+
+        void Finish(const TileRange& range)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            --in_flight;
+            tiles_left -= static_cast<int>(range.count);
+            changed.notify_all();
+        }
+
+        // unfinished is the range the worker held when it stopped, if any
+        void Retire(const TileRange& unfinished)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (unfinished.count != 0)
+            {
+                pending.push_front(unfinished);
+                --in_flight;
+            }
+            --live_workers;
+            changed.notify_all();
+        }
+    };
+
+    struct WorkerResult
+    {
+        uint32_t tiles_rendered = 0;
+        std::string error;      // Empty if the worker stayed up to the end
+    };
+
+    // Runs one worker's connection until the queue is empty or the connection fails
+    void DriveWorker(const WorkerAddress& address, const RenderJob& job, const std::string& scene_name,
+        const std::vector<Tile>& tiles, FrameBuffer& frame, WorkQueue& queue, WorkerResult& result)
+    {
+        TileRange range = { 0, 0 };   // Taken and not merged yet
+        const Socket connection = Socket::Connect(address.host.c_str(), address.port, result.error);
+        if (connection.IsValid())
+        {
+            std::string remote_error;
+            if (!SendValue(connection, job) || !connection.SendAll(scene_name.data(), scene_name.size())
+                || !ReceiveString(connection, remote_error))
+            {
+                result.error = "connection lost";
+            }
+            else
+            {
+                result.error = remote_error;
+            }
+        }
+
+        std::vector<float> colors;
+        std::vector<uint32_t> samples;
+        while (result.error.empty() && queue.Take(range))
+        {
+            const size_t pixels = CountTilePixels(tiles, range);
+            colors.resize(pixels * 3);
+            samples.resize(pixels);
+            if (!SendValue(connection, range)
+                || !connection.ReceiveAll(colors.data(), colors.size() * sizeof(float))
+                || !connection.ReceiveAll(samples.data(), samples.size() * sizeof(uint32_t)))
+            {
+                result.error = "connection lost";
+                break;
+            }
+
+            // Ranges never overlap, so merging needs no lock
+            CopyTilePixels(frame, tiles, range, colors.data(), samples.data(), true);
+            queue.Finish(range);
+            result.tiles_rendered += range.count;
+            range.count = 0;
+        }
+
+        if (result.error.empty())
+        {
+            SendValue(connection, TileRange{ 0, 0 });
+        }
+        queue.Retire(range);
+    }
+}
+
+bool RenderDistributed(const RenderSettings& settings, uint64_t scene_seed, FrameBuffer& frame,
+    const std::function<void(int)>& on_progress, std::string& error)
+{
+    std::vector<WorkerAddress> addresses;
+    if (!ParseWorkerAddresses(settings.worker_addresses, addresses, error))
+    {
+        return false;
+    }
+
+    const std::string scene_name = settings.GetSceneName();
+    if (scene_name.size() > max_scene_name_length)
+    {
+        error = "scene path too long";
+        return false;
+    }
+    const RenderJob job = MakeRenderJob(settings, scene_seed, scene_name);
+    const std::vector<Tile> tiles = MakeTiles(settings.image_width, settings.image_height, settings.tile_size);
+
+    WorkQueue queue;
+    const uint32_t tile_count = static_cast<uint32_t>(tiles.size());
+    const uint32_t range_size = std::max<uint32_t>(1, tile_count / static_cast<uint32_t>(addresses.size() * ranges_per_worker));
+    for (uint32_t first = 0; first < tile_count; first += range_size)
+    {
+        queue.pending.push_back({ first, std::min(range_size, tile_count - first) });
+    }
+    queue.tiles_left = static_cast<int>(tile_count);
+    queue.live_workers = static_cast<int>(addresses.size());
+
+    std::vector<WorkerResult> results(addresses.size());
+    std::vector<std::thread> connections;
+    for (size_t w = 0; w < addresses.size(); ++w)
+    {
+        connections.emplace_back(DriveWorker, std::cref(addresses[w]), std::cref(job), std::cref(scene_name),
+            std::cref(tiles), std::ref(frame), std::ref(queue), std::ref(results[w]));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        while (queue.tiles_left > 0 && queue.live_workers > 0)
+        {
+            if (on_progress)
+            {
+                on_progress(queue.tiles_left);
+            }
+            queue.changed.wait_for(lock, std::chrono::milliseconds(200), [&queue] { return queue.tiles_left == 0 || queue.live_workers == 0; });
+        }
+    }
+    for (std::thread& connection : connections)
+    {
+        connection.join();
+    }
+
+    std::cerr << "\x1b[2K\r";
+    for (size_t w = 0; w < addresses.size(); ++w)
+    {
+        std::cerr << "Worker " << addresses[w].GetName() << ": " << results[w].tiles_rendered << " tiles";
+        if (!results[w].error.empty())
+        {
+            std::cerr << ", failed: " << results[w].error;
+        }
+        std::cerr << std::endl;
+    }
+
+    if (queue.tiles_left > 0)
+    {
+        error = std::to_string(queue.tiles_left) + " tiles unfinished, no worker left";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../Render/FrameBuffer.h"
+#include "../Render/RenderSettings.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Renders the frame on the workers listed in settings.worker_addresses
+// ("host:port,host:port,..."), each running RunRenderWorker. Workers load the
+// scene themselves, so scene and OBJ files must exist at the same path on
+// every host.
+//
+// Tiles are handed out in small contiguous ranges as workers finish, so
+// faster hosts take more of the frame. A worker that fails gives its range
+// back to the others. Every pixel is rendered by exactly one worker with the
+// seeds a local render would use, so the merged frame matches a
+// single-process render bit for bit.
+//
+// on_progress, if set, gets the number of unfinished tiles every 200 ms.
+// Returns false and sets error if the addresses are malformed or no worker
+// is left to finish the frame.
+bool RenderDistributed(const RenderSettings& settings, uint64_t scene_seed, FrameBuffer& frame,
+    const std::function<void(int)>& on_progress, std::string& error);
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "Socket.h"
+#include "../Render/FrameBuffer.h"
+#include "../Render/RenderSettings.h"
+#include "../Render/Tile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Wire format between a render coordinator and its workers. Fields are fixed
+// size and little-endian, as on every machine the renderer builds for.
+//
+//   coordinator -> worker   RenderJob, then scene_name_length bytes of scene name
+//   worker -> coordinator   uint32 error length, then the error; length 0 once the scene is ready
+//   coordinator -> worker   TileRange, repeated; a range with count 0 ends the job
+//   worker -> coordinator   float color[3 * pixels], uint32 samples[pixels]
+//
+// A reply covers the pixels of the range's tiles, tile by tile and row by row
+// within a tile, where tiles are numbered as MakeTiles lists them. The values
+// are the worker's FrameBuffer entries, unrounded, so a merged frame is the
+// one a single process would have rendered.
+
+constexpr char render_job_magic[4] = { 'R', 'T', 'J', 'B' };
+constexpr uint32_t render_job_version = 1;
+constexpr uint32_t max_scene_name_length = 4096;
+
+// Workers allocate a full frame per job and run for a long time, so values
+// from the network are bounded before anything is sized from them. A
+// 16384x8192 frame (about 2 GB of FrameBuffer) is the largest accepted.
+constexpr int32_t max_job_dimension = 16384;
+constexpr int64_t max_job_pixels = int64_t(16384) * 8192;
+constexpr int32_t max_job_samples_per_pixel = 1 << 20;
+constexpr int32_t max_job_depth = 1024;
+
+struct RenderJob
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t scene_seed;
+    int32_t image_width;
+    int32_t image_height;
+    int32_t samples_per_pixel;
+    int32_t max_depth;
+    uint32_t russian_roulette;
+    int32_t roulette_min_depth;
+    uint32_t adaptive_sampling;
+    float adaptive_threshold;
+    int32_t min_samples_per_pixel;
+    int32_t adaptive_batch;
+    int32_t tile_size;
+    uint32_t integrator;         // IntegratorType
+    uint32_t packet_tracing;
+    uint32_t max_simd_level;     // SimdLevel; workers still cap it to their own CPU
+    uint32_t scene_source;       // SceneSource; files must be at the same path on every worker
+    uint32_t scene_name_length;
+};
+static_assert(sizeof(RenderJob) == 80, "RenderJob layout is part of the protocol");
+
+struct TileRange
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+inline RenderJob MakeRenderJob(const RenderSettings& settings, uint64_t scene_seed, const std::string& scene_name)
+{
+    RenderJob job = {};
+    std::memcpy(job.magic, render_job_magic, sizeof(job.magic));
+    job.version = render_job_version;
+    job.scene_seed = scene_seed;
+    job.image_width = settings.image_width;
+    job.image_height = settings.image_height;
+    job.samples_per_pixel = settings.samples_per_pixel;
+    job.max_depth = settings.max_depth;
+    job.russian_roulette = settings.russian_roulette;
+    job.roulette_min_depth = settings.roulette_min_depth;
+    job.adaptive_sampling = settings.adaptive_sampling;
+    job.adaptive_threshold = settings.adaptive_threshold;
+    job.min_samples_per_pixel = settings.min_samples_per_pixel;
+    job.adaptive_batch = settings.adaptive_batch;
+    job.tile_size = settings.tile_size;
+    job.integrator = static_cast<uint32_t>(settings.integrator);
+    job.packet_tracing = settings.packet_tracing;
+    job.max_simd_level = static_cast<uint32_t>(settings.max_simd_level);
+    job.scene_source = static_cast<uint32_t>(settings.GetSceneSource());
+    job.scene_name_length = static_cast<uint32_t>(scene_name.size());
+    return job;
+}
+
+// The scene fields are left alone; the worker sets them from scene_source
+inline void ApplyRenderJob(const RenderJob& job, RenderSettings& settings)
+{
+    settings.image_width = job.image_width;
+    settings.image_height = job.image_height;
+    settings.samples_per_pixel = job.samples_per_pixel;
+    settings.max_depth = job.max_depth;
+    settings.russian_roulette = job.russian_roulette != 0;
+    settings.roulette_min_depth = job.roulette_min_depth;
+    settings.adaptive_sampling = job.adaptive_sampling != 0;
+    settings.adaptive_threshold = job.adaptive_threshold;
+    settings.min_samples_per_pixel = job.min_samples_per_pixel;
+    settings.adaptive_batch = job.adaptive_batch;
+    settings.tile_size = job.tile_size;
+    settings.integrator = static_cast<IntegratorType>(job.integrator);
+    settings.packet_tracing = job.packet_tracing != 0;
+    settings.max_simd_level = static_cast<SimdLevel>(job.max_simd_level);
+}
+
+// Same limits ParseArguments puts on the options, so a worker never renders
+// a job its own command line would have refused, plus the size limits above.
+// Returns false and sets error for a job the worker must not render.
+inline bool IsValidRenderJob(const RenderJob& job, std::string& error)
+{
+    const bool well_formed = std::memcmp(job.magic, render_job_magic, sizeof(job.magic)) == 0
+        && job.version == render_job_version
+        && job.image_width > 0 && job.image_height > 0
+        && job.samples_per_pixel > 0 && job.max_depth > 0 && job.roulette_min_depth >= 0
+        && job.adaptive_threshold > 0.0f && job.min_samples_per_pixel >= 2 && job.adaptive_batch > 0
+        && job.tile_size > 0
+        && job.integrator <= static_cast<uint32_t>(IntegratorType::Wavefront)
+        && job.max_simd_level <= static_cast<uint32_t>(SimdLevel::AVX512)
+        && job.scene_source <= static_cast<uint32_t>(SceneSource::Obj)
+        && job.scene_name_length <= max_scene_name_length;
+    if (!well_formed)
+    {
+        error = "malformed job";
+        return false;
+    }
+
+    if (job.image_width > max_job_dimension || job.image_height > max_job_dimension
+        || static_cast<int64_t>(job.image_width) * job.image_height > max_job_pixels
+        || job.samples_per_pixel > max_job_samples_per_pixel || job.min_samples_per_pixel > max_job_samples_per_pixel
+        || job.max_depth > max_job_depth)
+    {
+        error = "job of " + std::to_string(job.image_width) + "x" + std::to_string(job.image_height) + ", "
+            + std::to_string(job.samples_per_pixel) + " spp, depth " + std::to_string(job.max_depth) + " exceeds the worker's limits";
+        return false;
+    }
+    return true;
+}
+
+inline size_t CountTilePixels(const std::vector<Tile>& tiles, const TileRange& range)
+{
+    size_t pixels = 0;
+    for (uint32_t t = range.first; t < range.first + range.count; ++t)
+    {
+        pixels += static_cast<size_t>(tiles[t].x1 - tiles[t].x0) * (tiles[t].y1 - tiles[t].y0);
+    }
+    return pixels;
+}
+
+// Copies the range's pixels between the frame and a reply, in reply order.
+// to_frame picks the direction.
+inline void CopyTilePixels(FrameBuffer& frame, const std::vector<Tile>& tiles, const TileRange& range, float* colors, uint32_t* samples, bool to_frame)
+{
+    for (uint32_t t = range.first; t < range.first + range.count; ++t)
+    {
+        const Tile& tile = tiles[t];
+        const int width = tile.x1 - tile.x0;
+        for (int j = tile.y0; j < tile.y1; ++j)
+        {
+            const size_t pixel = static_cast<size_t>(j) * frame.width + tile.x0;
+            float* frame_colors = &frame.color[pixel * 3];
+            uint32_t* frame_samples = &frame.sample_counts[pixel];
+            if (to_frame)
+            {
+                std::memcpy(frame_colors, colors, width * 3 * sizeof(float));
+                std::memcpy(frame_samples, samples, width * sizeof(uint32_t));
+            }
+            else
+            {
+                std::memcpy(colors, frame_colors, width * 3 * sizeof(float));
+                std::memcpy(samples, frame_samples, width * sizeof(uint32_t));
+            }
+            colors += width * 3;
+            samples += width;
+        }
+    }
+}
+
+template <typename T>
+bool SendValue(const Socket& socket, const T& value)
+{
+    return socket.SendAll(&value, sizeof(T));
+}
+
+template <typename T>
+bool ReceiveValue(const Socket& socket, T& value)
+{
+    return socket.ReceiveAll(&value, sizeof(T));
+}
+
+// uint32 length, then the characters
+inline bool SendString(const Socket& socket, const std::string& text)
+{
+    return SendValue(socket, static_cast<uint32_t>(text.size())) && socket.SendAll(text.data(), text.size());
+}
+
+// Refuses strings longer than max_length rather than allocating for them
+inline bool ReceiveString(const Socket& socket, std::string& text, uint32_t max_length = 1 << 16)
+{
+    uint32_t length = 0;
+    if (!ReceiveValue(socket, length) || length > max_length)
+    {
+        return false;
+    }
+    text.resize(length);
+    return socket.ReceiveAll(text.data(), length);
+}
@@ -0,0 +1,217 @@
+#include "Socket.h"
+
+#include <algorithm>
+#include <string>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+#if defined(_WIN32)
+    bool StartNetworking()
+    {
+        static const bool started = []
+            {
+                WSADATA data;
+                return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+            }();
+        return started;
+    }
+
+    void CloseSocket(uintptr_t handle)
+    {
+        closesocket(static_cast<SOCKET>(handle));
+    }
+#else
+    bool StartNetworking()
+    {
+        return true;
+    }
+
+    void CloseSocket(int handle)
+    {
+        close(handle);
+    }
+#endif
+
+    // Send and recv take an int length on Windows
+    constexpr size_t max_chunk = size_t(1) << 30;
+
+    // Requests and replies alternate, so Nagle's algorithm would only add latency
+    template <typename Handle>
+    void DisableNagle(Handle handle)
+    {
+        const int on = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+    }
+}
+
+Socket::~Socket()
+{
+    Close();
+}
+
+Socket::Socket(Socket&& other) noexcept : handle(other.handle)
+{
+    other.handle = invalid_handle;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        handle = other.handle;
+        other.handle = invalid_handle;
+    }
+    return *this;
+}
+
+void Socket::Close()
+{
+    if (IsValid())
+    {
+        CloseSocket(handle);
+        handle = invalid_handle;
+    }
+}
+
+Socket Socket::Connect(const char* host, uint16_t port, std::string& error)
+{
+    if (!StartNetworking())
+    {
+        error = "cannot start networking";
+        return Socket();
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    addrinfo* addresses = nullptr;
+    const std::string service = std::to_string(port);
+    if (getaddrinfo(host, service.c_str(), &hints, &addresses) != 0)
+    {
+        error = "cannot resolve host";
+        return Socket();
+    }
+
+    Socket connection;
+    for (const addrinfo* address = addresses; address; address = address->ai_next)
+    {
+        Socket candidate(static_cast<Handle>(socket(address->ai_family, address->ai_socktype, address->ai_protocol)));
+        if (candidate.IsValid() && connect(candidate.handle, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0)
+        {
+            connection = std::move(candidate);
+            break;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (!connection.IsValid())
+    {
+        error = "connection refused";
+        return Socket();
+    }
+    DisableNagle(connection.handle);
+    return connection;
+}
+
+Socket Socket::Listen(uint16_t port, std::string& error)
+{
+    if (!StartNetworking())
+    {
+        error = "cannot start networking";
+        return Socket();
+    }
+
+    Socket listener(static_cast<Handle>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)));
+    if (!listener.IsValid())
+    {
+        error = "cannot create socket";
+        return Socket();
+    }
+
+    // A restarted worker can take its port back while old connections linger
+    const int on = 1;
+    setsockopt(listener.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener.handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        error = "cannot bind port " + std::to_string(port);
+        return Socket();
+    }
+    if (listen(listener.handle, SOMAXCONN) != 0)
+    {
+        error = "cannot listen on port " + std::to_string(port);
+        return Socket();
+    }
+    return listener;
+}
+
+Socket Socket::Accept() const
+{
+    Socket connection(static_cast<Handle>(accept(handle, nullptr, nullptr)));
+    if (connection.IsValid())
+    {
+        DisableNagle(connection.handle);
+    }
+    return connection;
+}
+
+bool Socket::SendAll(const void* data, size_t size) const
+{
+#if defined(MSG_NOSIGNAL)
+    constexpr int flags = MSG_NOSIGNAL;   // Report a closed peer as an error rather than by SIGPIPE
+#else
+    constexpr int flags = 0;
+#endif
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const auto sent = send(handle, bytes, static_cast<int>(std::min(size, max_chunk)), flags);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool Socket::ReceiveAll(void* data, size_t size) const
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const auto received = recv(handle, bytes, static_cast<int>(std::min(size, max_chunk)), 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
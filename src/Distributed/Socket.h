@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Blocking TCP stream socket, closed on destruction. Winsock and BSD sockets
+// behind one interface; the platform headers stay in Socket.cpp.
+class Socket
+{
+public:
+    Socket() = default;
+    ~Socket();
+
+    Socket(Socket&& other) noexcept;
+    Socket& operator=(Socket&& other) noexcept;
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    // Tries every address host resolves to. Returns an invalid socket and
+    // sets error if none accepts the connection.
+    static Socket Connect(const char* host, uint16_t port, std::string& error);
+
+    // Listens on port on every IPv4 interface
+    static Socket Listen(uint16_t port, std::string& error);
+
+    // Waits for the next connection; returns an invalid socket on failure
+    Socket Accept() const;
+
+    bool IsValid() const
+    {
+        return handle != invalid_handle;
+    }
+
+    // Both return false if the connection fails or is closed before size bytes
+    bool SendAll(const void* data, size_t size) const;
+    bool ReceiveAll(void* data, size_t size) const;
+
+private:
+#if defined(_WIN32)
+    using Handle = uintptr_t;   // SOCKET
+    static constexpr Handle invalid_handle = ~Handle(0);
+#else
+    using Handle = int;
+    static constexpr Handle invalid_handle = -1;
+#endif
+
+    explicit Socket(Handle _handle) : handle(_handle)
+    {
+    }
+
+    void Close();
+
+    Handle handle = invalid_handle;
+};
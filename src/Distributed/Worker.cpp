@@ -0,0 +1,177 @@
+#include "Worker.h"
+#include "Protocol.h"
+#include "../Camera.h"
+#include "../CpuFeatures.h"
+#include "../Objects/BVH.h"
+#include "../Render/Renderer.h"
+#include "../Scenes/ObjLoader.h"
+#include "../Scenes/SceneFile.h"
+#include "../Scenes/SphereField.h"
+#include "../ThreadPool/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // The scene of the previous job, kept for the next one
+    struct LoadedScene
+    {
+        SceneSource source = SceneSource::Builtin;
+        std::string name;
+        uint64_t seed = 0;
+        SimdLevel simd_level = SimdLevel::Scalar;   // Sphere kernels are bound when the scene and BVH are built
+        std::unique_ptr<const Scene> scene;
+        std::unique_ptr<const BVH> world;
+
+        bool Matches(SceneSource _source, const std::string& _name, uint64_t _seed, SimdLevel _simd_level) const
+        {
+            return scene && source == _source && name == _name && seed == _seed && simd_level == _simd_level;
+        }
+    };
+
+    bool LoadScene(SceneSource source, const std::string& name, uint64_t seed, LoadedScene& loaded, std::string& error)
+    {
+        if (loaded.Matches(source, name, seed, ActiveSimdLevel()))
+        {
+            return true;
+        }
+
+        loaded.world.reset();
+        const Scene* scene = source == SceneSource::SceneFile ? LoadSceneFile(name.c_str(), error)
+            : source == SceneSource::Obj ? LoadObjScene(name.c_str(), error)
+            : Make_scene(name.c_str(), seed);
+        loaded.scene.reset(scene);
+        if (!scene)
+        {
+            if (source == SceneSource::Builtin)
+            {
+                error = "unknown built-in scene " + name;
+            }
+            return false;
+        }
+        loaded.world = std::make_unique<const BVH>(scene->objects);
+        loaded.source = source;
+        loaded.name = name;
+        loaded.seed = seed;
+        loaded.simd_level = ActiveSimdLevel();
+        return true;
+    }
+
+    // Returns false if the connection fails or the job is malformed. A scene
+    // that cannot be loaded is reported to the coordinator instead.
+    bool ServeJob(const Socket& connection, ThreadPool& threads, LoadedScene& loaded, std::string& error)
+    {
+        RenderJob job;
+        std::string scene_name;
+        if (!ReceiveValue(connection, job))
+        {
+            error = "no job received";
+            return false;
+        }
+        if (!IsValidRenderJob(job, error))
+        {
+            return false;
+        }
+        scene_name.resize(job.scene_name_length);
+        if (!connection.ReceiveAll(scene_name.data(), scene_name.size()))
+        {
+            error = "connection lost";
+            return false;
+        }
+
+        RenderSettings settings;
+        ApplyRenderJob(job, settings);
+        // Set rather than lowered, so a job capped to scalar kernels does not cap
+        // the next one; a cached scene is only reused at the same level
+        ActiveSimdLevel() = std::min(DetectSimdLevel(), settings.max_simd_level);
+
+        const std::chrono::steady_clock::time_point load_begin = std::chrono::steady_clock::now();
+        std::string scene_error;
+        const bool loaded_scene = LoadScene(static_cast<SceneSource>(job.scene_source), scene_name, job.scene_seed, loaded, scene_error);
+        if (!SendString(connection, scene_error) || !loaded_scene)
+        {
+            error = loaded_scene ? "connection lost" : "cannot load " + scene_name + ": " + scene_error;
+            return false;
+        }
+        std::cerr << "Job " << settings.image_width << "x" << settings.image_height << ", " << settings.samples_per_pixel << " spp of " << scene_name
+            << ", scene ready in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - load_begin).count() << "ms" << std::endl;
+
+        // Full size, so tiles render at their usual pixels; only requested tiles are ever filled
+        FrameBuffer frame(settings.image_width, settings.image_height);
+        const Camera camera = loaded.scene->CreateCamera(settings.GetAspectRatio());
+        Renderer renderer(settings, camera, *loaded.scene, *loaded.world, frame);
+        const std::vector<Tile> tiles = MakeTiles(settings.image_width, settings.image_height, settings.tile_size);
+
+        std::vector<float> colors;
+        std::vector<uint32_t> samples;
+        uint32_t tiles_rendered = 0;
+        while (true)
+        {
+            TileRange range;
+            if (!ReceiveValue(connection, range))
+            {
+                error = "connection lost";
+                return false;
+            }
+            if (range.count == 0)
+            {
+                break;
+            }
+            if (range.first >= tiles.size() || range.count > tiles.size() - range.first)
+            {
+                error = "tile range out of bounds";
+                return false;
+            }
+
+            renderer.RenderTiles(threads, std::vector<Tile>(tiles.begin() + range.first, tiles.begin() + range.first + range.count));
+
+            const size_t pixels = CountTilePixels(tiles, range);
+            colors.resize(pixels * 3);
+            samples.resize(pixels);
+            CopyTilePixels(frame, tiles, range, colors.data(), samples.data(), false);
+            if (!connection.SendAll(colors.data(), colors.size() * sizeof(float))
+                || !connection.SendAll(samples.data(), samples.size() * sizeof(uint32_t)))
+            {
+                error = "connection lost";
+                return false;
+            }
+            tiles_rendered += range.count;
+        }
+
+        std::cerr << "Job done, " << tiles_rendered << " of " << tiles.size() << " tiles rendered here" << std::endl;
+        return true;
+    }
+}
+
+bool RunRenderWorker(uint16_t port, uint32_t thread_count, const std::vector<uint32_t>& cpus, std::string& error)
+{
+    const Socket listener = Socket::Listen(port, error);
+    if (!listener.IsValid())
+    {
+        return false;
+    }
+
+    ThreadPool threads;
+    threads.Start(thread_count, cpus);
+    std::cerr << "Worker listening on port " << port << " with " << threads.GetThreadCount() << " threads" << std::endl;
+
+    LoadedScene loaded;
+    while (true)
+    {
+        const Socket connection = listener.Accept();
+        if (!connection.IsValid())
+        {
+            continue;
+        }
+
+        std::string job_error;
+        if (!ServeJob(connection, threads, loaded, job_error))
+        {
+            std::cerr << "Job failed: " << job_error << std::endl;
+        }
+    }
+}
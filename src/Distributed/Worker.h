@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Serves render jobs from coordinators (see Coordinator.h) on port, one
+// connection at a time, rendering with thread_count threads (0 for all
+// cores), pinned to cpus unless it is empty. The last scene stays loaded, so repeated jobs on the same scene
+// skip the load. Runs until the process is stopped; returns false and sets
+// error only if the port cannot be opened.
+bool RunRenderWorker(uint16_t port, uint32_t thread_count, const std::vector<uint32_t>& cpus, std::string& error);
@@ -1,165 +1,270 @@
-#include <iostream>
 #include <chrono>
-#include <thread>
-#include <fstream>
+#include <iostream>
+#include <string>
 #include "Vector3Float.h"
 #include "Camera.h"
-#include "Utils.h"
-#include "Materials/Dielectric.h"
-#include "Objects/HittableList.h"
-#include "Materials/Lambertian.h"
-#include "Materials/Metal.h"
-#include "Objects/Sphere.h"
+#include "Counters.h"
+#include "Distributed/Coordinator.h"
+#include "Distributed/Worker.h"
+#include "Objects/BVH.h"
+#include "Output/ImageStream.h"
+#include "Output/ImageWriter.h"
+#include "Render/Checkpoint.h"
+#include "Render/Denoiser.h"
+#include "Render/FrameBuffer.h"
+#include "Render/Renderer.h"
+#include "Render/RenderSettings.h"
+#include "Render/Sequence.h"
+#include "Scenes/Animation.h"
+#include "Scenes/ObjLoader.h"
+#include "Scenes/SceneFile.h"
+#include "Scenes/SphereField.h"
+#include "ThreadPool/CpuTopology.h"
 #include "ThreadPool/ThreadPool.h"
 
 
-const int image_width = 1000;
-const int image_height = 1000;
-const int samples_per_pixel = 20;
-const int max_depth = 30;
-const auto aspect_ratio = static_cast<float>(image_width) / image_height;
-
-const Vector3 lookfrom(13, 2, 3);
-const Vector3 lookat(0, 0, 0);
-const Vector3 vup(0, 1, 0);
-const auto dist_to_focus = 7.0;
-const auto aperture = 0.1;
-
-const char* imageName = "image.ppm";
-
-const Camera cam(lookfrom, lookat, vup, 20, aspect_ratio, aperture, dist_to_focus);
-const HittableList* world = nullptr;
+const uint64_t scene_seed = 0;
 
-float* image_buffer = nullptr;
-
-Vector3 Ray_color(const Ray& r, const HittableList* world, int depth)
+int main(int argc, char** argv)
 {
-    HitRecord rec;
-
-    if (depth <= 0)
+    RenderSettings settings;
+    if (!ParseArguments(argc, argv, settings))
     {
-        return Vector3(0, 0, 0);
+        PrintUsage(argv[0]);
+        return 1;
     }
 
-    if (world->Hit(r, 0.001, infinity, rec))
+    LimitSimdLevel(settings.max_simd_level);
+
+    std::string error;
+    std::vector<uint32_t> worker_cpus;   // Empty leaves the workers unpinned
+    if (settings.pin_threads || settings.cpu_list || settings.numa_placement)
     {
-        Ray scattered;
-        Vector3 attenuation;
+        std::vector<uint32_t> allowed;
+        if (settings.cpu_list && !ParseCpuList(settings.cpu_list, allowed))
+        {
+            std::cerr << "Malformed CPU list " << settings.cpu_list << std::endl;
+            return 1;
+        }
+        const CpuTopology topology = GetCpuTopology();
+        if (!PlaceWorkers(topology, allowed, settings.thread_count, worker_cpus, error))
+        {
+            std::cerr << "Cannot place workers: " << error << std::endl;
+            return 1;
+        }
+        std::cerr << "Pinning " << worker_cpus.size() << " workers, " << topology.node_count << " NUMA node(s)" << std::endl;
+    }
 
-        if (rec.mat_ptr->Scatter(r, rec, attenuation, scattered))
+    if (settings.convert_text)
+    {
+        if (!ConvertSceneText(settings.convert_text, settings.convert_output, settings.store_scene_bvh, error))
         {
-            return attenuation * Ray_color(scattered, world, depth - 1);
+            std::cerr << "Scene conversion failed: " << error << std::endl;
+            return 1;
         }
+        return 0;
+    }
 
-        return Vector3(0, 0, 0);
+    if (settings.worker_port)
+    {
+        if (!RunRenderWorker(static_cast<uint16_t>(settings.worker_port), settings.thread_count, worker_cpus, error))
+        {
+            std::cerr << "Worker failed: " << error << std::endl;
+            return 1;
+        }
+        return 0;
     }
 
-    const Vector3 unit_direction = r.GetDirection().GetNormalized();
-    const auto t = 0.5 * (unit_direction.y + 1.0);
-    return (1.0 - t) * Vector3(1.0, 1.0, 1.0) + t * Vector3(0.5, 0.7, 1.0);
-}
+    const int image_width = settings.image_width;
+    const int image_height = settings.image_height;
+    const auto show_progress = [](int tiles_left)
+        {
+            std::cerr << "\r" << "Tiles left: " << tiles_left << "   " << std::flush;
+        };
 
-void Pixel_color(int i, int j)
-{
-    Vector3 color(0, 0, 0);
+    if (settings.worker_addresses && (settings.resume_file || settings.checkpoint_file))
+    {
+        std::cerr << "Checkpoints are not supported for distributed renders" << std::endl;
+        return 1;
+    }
+    if (settings.worker_addresses && settings.denoise)
+    {
+        std::cerr << "Denoising is not supported for distributed renders" << std::endl;
+        return 1;
+    }
+    if (settings.animation_file && (settings.worker_addresses || settings.resume_file || settings.checkpoint_file))
+    {
+        std::cerr << "Animations cannot be rendered distributed or from checkpoints" << std::endl;
+        return 1;
+    }
 
-    for (int s = 0; s < samples_per_pixel; ++s)
+    Animation animation;
+    if (settings.animation_file && !LoadAnimation(settings.animation_file, animation, error))
     {
-        const auto u = (i + random_float()) / image_width;
-        const auto v = (j + random_float()) / image_height;
-        Ray r = cam.GetRay(u, v);
-        color += Ray_color(r, world, max_depth);
+        std::cerr << "Cannot load animation: " << error << std::endl;
+        return 1;
     }
-    int index = (j * image_width + i) * 3;
-    image_buffer[index++] = color.r;
-    image_buffer[index++] = color.g;
-    image_buffer[index] = color.b;
-}
 
-HittableList* random_scene()
-{
-    HittableList* world = new HittableList();
+    // An adaptive render resumes exactly only with every pixel's statistics;
+    // the denoiser estimates each pixel's noise from them
+    const bool track_stats = (settings.adaptive_sampling && (settings.resume_file || settings.checkpoint_file)) || settings.denoise;
+    // Under NUMA placement the workers zero the frame themselves, so each
+    // one's block of it is placed on its node; a resumed frame is already filled
+    const bool first_touch = settings.numa_placement && !settings.worker_addresses && !settings.animation_file && !settings.resume_file;
+    FrameBuffer* frame = new FrameBuffer(image_width, image_height, track_stats, settings.denoise, !first_touch);
+    if (settings.resume_file && !LoadCheckpoint(settings.resume_file, settings, scene_seed, *frame, error))
+    {
+        std::cerr << "Cannot resume from " << settings.resume_file << ": " << error << std::endl;
+        return 1;
+    }
 
-    world->Add(std::make_shared<Sphere>(Vector3(0, -1000, 0), 1000, std::make_shared<Lambertian>(Vector3(0.5, 0.5, 0.5))));
+    ThreadPool* threads = new ThreadPool();
+    std::chrono::steady_clock::time_point begin;
+    const std::unique_ptr<ImageWriter> writer = MakeImageWriter(settings.image_format);
+    std::unique_ptr<ImageStream> stream;
 
-    for (int a = -11; a < 11; ++a)
+    if (settings.worker_addresses)
+    {
+        // The workers load the scene; this process only merges and writes the image
+        threads->Start(settings.thread_count, worker_cpus);
+        begin = std::chrono::steady_clock::now();
+        if (!RenderDistributed(settings, scene_seed, *frame, show_progress, error))
+        {
+            std::cerr << "Distributed render failed: " << error << std::endl;
+            return 1;
+        }
+    }
+    else
     {
-        for (int b = -11; b < 11; ++b)
+        std::chrono::steady_clock::time_point load_begin = std::chrono::steady_clock::now();
+        Scene* scene = settings.scene_file ? LoadSceneFile(settings.scene_file, error)
+            : settings.obj_file ? LoadObjScene(settings.obj_file, error)
+            : Make_scene(settings.builtin_scene, scene_seed);
+        if (!scene)
         {
-            const auto choose_mat = random_float();
-            Vector3 center(a + 0.9 * random_float(), 0.2, b + 0.9 * random_float());
-            if ((center - Vector3(4, 0.2, 0)).GetLength() > 0.9)
+            if (!settings.scene_file && !settings.obj_file)
             {
-                if (choose_mat < 0.8)
-                {
-                    auto albedo = Vector3::Random() * Vector3::Random();
-                    world->Add(std::make_shared<Sphere>(center, 0.2, std::make_shared<Lambertian>(albedo)));
-                }
-                else if (choose_mat < 0.95)
-                {
-                    auto albedo = Vector3::Random(0.5, 1);
-                    auto fuzz = random_float(0, 0.5);
-                    world->Add(std::make_shared<Sphere>(center, 0.2, std::make_shared<Metal>(albedo, fuzz)));
-                }
-                else
-                {
-                    world->Add(std::make_shared<Sphere>(center, 0.2, std::make_shared<Dielectric>(1.5)));
-                }
+                std::cerr << "Unknown built-in scene " << settings.builtin_scene << std::endl;
+                return 1;
             }
+            std::cerr << "Cannot load " << (settings.scene_file ? settings.scene_file : settings.obj_file) << ": " << error << std::endl;
+            return 1;
         }
-    }
-
-    world->Add(std::make_shared<Sphere>(Vector3(0, 1, 0), 1.0, std::make_shared<Dielectric>(1.5)));
+        std::cerr << "Scene loaded in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - load_begin).count() << "ms" << std::endl;
 
-    world->Add(std::make_shared<Sphere>(Vector3(-4, 1, -2), 1.0, std::make_shared<Lambertian>(Vector3(0.4, 0.2, 0.1))));
+        if (settings.animation_file)
+        {
+            threads->Start(settings.thread_count, worker_cpus);
+            const bool rendered = RenderSequence(settings, *scene, animation, *threads, error);
+            threads->Stop();
+            if (!rendered)
+            {
+                std::cerr << "\nAnimation failed: " << error << std::endl;
+                return 1;
+            }
+            std::cerr << "\nDone.\n";
+            return 0;
+        }
 
-    world->Add(std::make_shared<Sphere>(Vector3(4, 1, 0), 1.0, std::make_shared<Metal>(Vector3(0.7, 0.6, 0.5), 0.0)));
+        const Camera* cam = new Camera(scene->CreateCamera(settings.GetAspectRatio()));
+        const Hittable* world = new BVH(scene->objects);
+        Renderer* renderer = new Renderer(settings, *cam, *scene, *world, *frame);
 
-    return world;
-}
+        // Encoding and writing follow the render band by band, unless the
+        // denoiser needs the finished frame first
+        if (settings.stream_output && !settings.denoise)
+        {
+            stream = std::make_unique<ImageStream>(*writer, *frame, settings.tile_size);
+            if (!stream->Open(settings.image_name))
+            {
+                std::cerr << "Could not write " << settings.image_name << std::endl;
+                return 1;
+            }
+        }
+        std::vector<Tile> tiles = MakeTiles(image_width, image_height, settings.tile_size);
+        if (stream)
+        {
+            tiles = stream->OrderTiles(std::move(tiles));
+        }
 
-int main()
-{
-    image_buffer = new float[image_height * image_width * 3];
-    world = random_scene();
+        threads->Start(settings.thread_count, worker_cpus);
+        if (first_touch)
+        {
+            renderer->FirstTouch(*threads, tiles);
+        }
 
-    ThreadPool* threads = new ThreadPool();
-    threads->Start();
-    
-    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
-    for (int j = 0; j < image_height; j++)
-    {
-        for (int i = 0; i < image_width; i++)
+        begin = std::chrono::steady_clock::now();
+        if (settings.checkpoint_file && settings.checkpoint_interval > 0)
+        {
+            TileCheckpointer checkpointer(*frame);
+            std::chrono::steady_clock::time_point last_save = begin;
+            const auto save_periodically = [&](int tiles_left)
+                {
+                    show_progress(tiles_left);
+                    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                    if (now - last_save >= std::chrono::seconds(settings.checkpoint_interval))
+                    {
+                        if (!checkpointer.Save(settings, scene_seed, settings.checkpoint_file, error))
+                        {
+                            std::cerr << "\nCheckpoint failed: " << error << std::endl;
+                        }
+                        last_save = now;
+                    }
+                };
+            renderer->RenderTiles(*threads, tiles, save_periodically, [&checkpointer, &stream](const Tile& tile)
+                {
+                    checkpointer.CommitTile(tile);
+                    if (stream)
+                    {
+                        stream->CommitTile(tile);
+                    }
+                });
+        }
+        else if (stream)
+        {
+            renderer->RenderTiles(*threads, tiles, show_progress, [&stream](const Tile& tile) { stream->CommitTile(tile); });
+        }
+        else
         {
-            threads->QueueJob([i, j] {Pixel_color(i, j); });
+            renderer->Render(*threads, show_progress);
         }
     }
+    std::cerr << "\r" << "Tiles left: " << 0 << "   " << std::flush;
 
-    while (auto n = threads->GetJobsCount())
+    if (settings.checkpoint_file && !SaveCheckpoint(*frame, settings, scene_seed, settings.checkpoint_file, error))
     {
-        std::cerr << "\r" << "Pixels left: " << n << "   " << std::flush;
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        std::cerr << "\nCould not save checkpoint: " << error << std::endl;
+        return 1;
     }
-    std::cerr << "\r" << "Pixels left: " << 0 << "   " << std::flush;
-    threads->Stop();
 
-    std::ofstream img_file;
-    img_file.open(imageName);
+    std::chrono::steady_clock::duration denoise_time(0);
+    if (settings.denoise)
+    {
+        const std::chrono::steady_clock::time_point denoise_begin = std::chrono::steady_clock::now();
+        Denoise(*frame, *threads);
+        denoise_time = std::chrono::steady_clock::now() - denoise_begin;
+    }
 
-    img_file << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-    for (int j = image_height - 1; j >= 0; --j)
+    const bool written = stream ? stream->Finish() : writer->Write(*frame, *threads, settings.image_name);
+    threads->Stop();
+    if (!written)
     {
-        for (int i = 0; i < image_width; ++i)
-        {
-            int index = (j * image_width + i) * 3;
-            Vector3::NormalizeAndOutput(image_buffer[index], image_buffer[index+1], image_buffer[index+2], img_file, samples_per_pixel);
-        }
+        std::cerr << "\nCould not write " << settings.image_name << std::endl;
+        return 1;
     }
-    img_file.close();
 
     std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
     std::cerr << "\x1b[2K";
-    std::cerr << "\rElapsed time = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "ms" << std::endl;
+    std::cerr << "\rElapsed time = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin - denoise_time).count() << "ms" << std::endl;
+    if (settings.denoise)
+    {
+        std::cerr << "Denoise time = " << std::chrono::duration_cast<std::chrono::milliseconds>(denoise_time).count() << "ms" << std::endl;
+    }
+    std::cerr << "Average samples per pixel = " << static_cast<double>(frame->GetTotalSamples()) / (image_width * image_height) << std::endl;
+#if defined(RT_STATS)
+    std::cerr << '\n';
+    Counters::Collect().Print(std::cerr);
+#endif
     std::cerr << "\nDone.\n";
 
     return 0;
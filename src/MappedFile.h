@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first
+// access, so opening costs the same for any file size.
+class MappedFile
+{
+public:
+    // Returns nullptr if the file cannot be opened or mapped
+    static std::shared_ptr<MappedFile> Open(const char* path)
+    {
+        std::shared_ptr<MappedFile> file(new MappedFile());
+#if defined(_WIN32)
+        file->handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file->handle == INVALID_HANDLE_VALUE)
+        {
+            return nullptr;
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file->handle, &size) || size.QuadPart == 0)
+        {
+            return nullptr;
+        }
+        file->size = static_cast<size_t>(size.QuadPart);
+        file->mapping = CreateFileMappingA(file->handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!file->mapping)
+        {
+            return nullptr;
+        }
+        file->data = static_cast<const uint8_t*>(MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            return nullptr;
+        }
+        file->size = static_cast<size_t>(info.st_size);
+        void* address = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);   // The mapping keeps its own reference to the file
+        file->data = address == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(address);
+#endif
+        return file->data ? file : nullptr;
+    }
+
+    ~MappedFile()
+    {
+#if defined(_WIN32)
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+#else
+        if (data) munmap(const_cast<uint8_t*>(data), size);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* GetData() const
+    {
+        return data;
+    }
+
+    size_t GetSize() const
+    {
+        return size;
+    }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+#if defined(_WIN32)
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
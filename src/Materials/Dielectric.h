@@ -1,11 +1,13 @@
 #pragma once
 
-#include "material.h"
+#include "Material.h"
 #include "../Objects/Hittable.h"
 
-class Dielectric : public Material
+class Dielectric final : public Material
 {
 public:
+    static constexpr MaterialType type = MaterialType::Dielectric;
+
     Dielectric(float ri) : ref_idx(ri)
     {       
     }
@@ -13,13 +15,13 @@ public:
     bool Scatter(const Ray& r_in, const HitRecord& rec, Vector3& attenuation, Ray& scattered) const override
     {
         attenuation = Vector3(1.0f, 1.0f, 1.0f);
-        const float etai_over_etat = rec.front_face ? (1.0 / ref_idx) : ref_idx;
+        const float etai_over_etat = rec.front_face ? (kernel_real(1) / ref_idx) : ref_idx;
 
         const Vector3 unit_direction = r_in.GetDirection().GetNormalized();
-        const float cos_theta = ffmin(Vector3::Dot(-unit_direction, rec.normal), 1.0);
-        const float sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+        const float cos_theta = ffmin(Vector3::Dot(-unit_direction, rec.normal), 1.0f);
+        const float sin_theta = std::sqrt(kernel_real(1) - cos_theta * cos_theta);
 
-        if (etai_over_etat * sin_theta > 1.0)
+        if (etai_over_etat * sin_theta > 1.0f)
         {
             const Vector3 reflected = Vector3::Reflect(unit_direction, rec.normal);
             scattered = Ray(rec.p, reflected);
@@ -3,9 +3,11 @@
 #include "Material.h"
 #include "../Objects/Hittable.h"
 
-class Lambertian : public Material
+class Lambertian final : public Material
 {
 public:
+    static constexpr MaterialType type = MaterialType::Lambertian;
+
     Lambertian(const Vector3& a) : albedo(a)
     {
     }
@@ -1,8 +1,19 @@
 #pragma once
 #include "../Ray.h"
 
+#include <cstdint>
+
 struct HitRecord;
 
+// Tag for the built-in materials, so batched shading can dispatch without a virtual call
+enum class MaterialType : uint8_t
+{
+    Lambertian,
+    Metal,
+    Dielectric,
+    Custom
+};
+
 class Material
 {
 public:
@@ -10,10 +21,17 @@ public:
     virtual bool Scatter(const Ray& r_in, const HitRecord& rec, Vector3& attenuation, Ray& scattered) const = 0;
 };
 
-float Schlick(float cosine, float ref_idx)
+inline float Schlick(float cosine, float ref_idx)
 {
     auto r0 = (1 - ref_idx) / (1 + ref_idx);
     r0 = r0 * r0;
 
+#if defined(RT_FAST_MATH)
+    // (1 - cosine)^5 as three multiplications instead of a double pow
+    const float m = 1 - cosine;
+    const float m2 = m * m;
+    return r0 + (1 - r0) * (m2 * m2 * m);
+#else
     return r0 + (1 - r0) * pow((1 - cosine), 5);
+#endif
 }
\ No newline at end of file
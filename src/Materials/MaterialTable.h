@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Dielectric.h"
+#include "Lambertian.h"
+#include "Material.h"
+#include "Metal.h"
+#include "../Objects/Hittable.h"
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// Owns every material of a scene. Geometry refers to materials by MaterialId,
+// so the trace loop never touches a reference count.
+//
+// The built-in materials are stored by value in one contiguous array and are
+// dispatched with a switch on the variant index; any other Material is kept
+// behind a pointer and called virtually.
+class MaterialTable
+{
+public:
+    template <typename T, typename... Args>
+    MaterialId Add(Args&&... args)
+    {
+        if constexpr (std::is_same_v<T, Lambertian> || std::is_same_v<T, Metal> || std::is_same_v<T, Dielectric>)
+        {
+            materials.emplace_back(std::in_place_type<T>, std::forward<Args>(args)...);
+        }
+        else
+        {
+            materials.emplace_back(std::in_place_type<std::unique_ptr<Material>>, std::make_unique<T>(std::forward<Args>(args)...));
+        }
+        return static_cast<MaterialId>(materials.size() - 1);
+    }
+
+    const Material& operator[](MaterialId id) const
+    {
+        return std::visit([](const auto& material) -> const Material&
+            {
+                if constexpr (std::is_same_v<std::decay_t<decltype(material)>, std::unique_ptr<Material>>)
+                {
+                    return *material;
+                }
+                else
+                {
+                    return material;
+                }
+            }, materials[id]);
+    }
+
+    // Same as operator[](id).Scatter, but the built-in materials are final
+    // here, so their Scatter is called directly and can be inlined
+    bool Scatter(MaterialId id, const Ray& r_in, const HitRecord& rec, Vector3& attenuation, Ray& scattered) const
+    {
+        return std::visit([&](const auto& material)
+            {
+                if constexpr (std::is_same_v<std::decay_t<decltype(material)>, std::unique_ptr<Material>>)
+                {
+                    return material->Scatter(r_in, rec, attenuation, scattered);
+                }
+                else
+                {
+                    return material.Scatter(r_in, rec, attenuation, scattered);
+                }
+            }, materials[id]);
+    }
+
+    MaterialType GetType(MaterialId id) const
+    {
+        return static_cast<MaterialType>(materials[id].index());
+    }
+
+    size_t GetSize() const
+    {
+        return materials.size();
+    }
+
+private:
+    // Alternatives are in MaterialType order, so the index is the type tag
+    using StoredMaterial = std::variant<Lambertian, Metal, Dielectric, std::unique_ptr<Material>>;
+    static_assert(static_cast<size_t>(Lambertian::type) == 0 && static_cast<size_t>(Metal::type) == 1
+        && static_cast<size_t>(Dielectric::type) == 2 && static_cast<size_t>(MaterialType::Custom) == 3,
+        "StoredMaterial alternatives must follow MaterialType");
+
+    std::vector<StoredMaterial> materials;
+};
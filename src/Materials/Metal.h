@@ -3,10 +3,12 @@
 #include "../Objects/Hittable.h"
 #include "Material.h"
 
-class Metal : public Material
+class Metal final : public Material
 {
 public:
-    Metal(const Vector3& a, double f) : albedo(a), fuzz(f < 1 ? f : 1)
+    static constexpr MaterialType type = MaterialType::Metal;
+
+    Metal(const Vector3& a, float f) : albedo(a), fuzz(f < 1 ? f : 1)
     {
     }
 
@@ -20,5 +22,5 @@ public:
     }
 
     Vector3 albedo;
-    double fuzz;
+    float fuzz;
 };
\ No newline at end of file
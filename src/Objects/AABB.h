@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../Ray.h"
+
+class AABB
+{
+public:
+    AABB()
+        : minimum(infinity, infinity, infinity), maximum(-infinity, -infinity, -infinity)
+    {
+    }
+
+    AABB(const Point3& a, const Point3& b) : minimum(a), maximum(b)
+    {
+    }
+
+    void Grow(const Point3& p)
+    {
+        minimum = Vector3(ffmin(minimum.x, p.x), ffmin(minimum.y, p.y), ffmin(minimum.z, p.z));
+        maximum = Vector3(ffmax(maximum.x, p.x), ffmax(maximum.y, p.y), ffmax(maximum.z, p.z));
+    }
+
+    void Grow(const AABB& box)
+    {
+        Grow(box.minimum);
+        Grow(box.maximum);
+    }
+
+    Point3 GetCentroid() const
+    {
+        return 0.5f * (minimum + maximum);
+    }
+
+    float GetSurfaceArea() const
+    {
+        const Vector3 d = maximum - minimum;
+        if (d.x < 0 || d.y < 0 || d.z < 0)
+        {
+            return 0.0f;
+        }
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    int GetLongestAxis() const
+    {
+        const Vector3 d = maximum - minimum;
+        if (d.x > d.y && d.x > d.z)
+        {
+            return 0;
+        }
+        return d.y > d.z ? 1 : 2;
+    }
+
+    static AABB Surround(const AABB& a, const AABB& b)
+    {
+        AABB box = a;
+        box.Grow(b);
+        return box;
+    }
+
+    Point3 minimum;
+    Point3 maximum;
+};
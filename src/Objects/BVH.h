@@ -0,0 +1,268 @@
+#pragma once
+
+#include "BVHNode.h"
+#include "HitDispatch.h"
+#include "Hittable.h"
+#include "HittableList.h"
+#include "../Counters.h"
+#include "../CpuFeatures.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#if defined(RT_X86)
+#include <emmintrin.h>
+#endif
+
+// Bounding volume hierarchy over arbitrary Hittables
+class BVH : public Hittable
+{
+public:
+    explicit BVH(const HittableList& list, int max_leaf_size = 4);
+
+    bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const override;
+    uint32_t HitPacket(const RayPacket& packet, uint32_t active, float t_min, float* lane_t_max, HitRecord* recs) const override;
+
+    AABB GetBoundingBox() const override
+    {
+        return bounds;
+    }
+
+    size_t GetNodeCount() const
+    {
+        return nodes.size();
+    }
+
+    // Recomputes every node's bounds from the primitives' current boxes and
+    // keeps the tree, which is far cheaper than a rebuild when primitives
+    // have moved. Returns the total node surface area over the area right
+    // after the build: traversal cost grows with it, and a caller rebuilds
+    // once it gets large.
+    float Refit();
+
+private:
+    static uint32_t IntersectPacket(const BVHNode& node, const RayPacket& packet, uint32_t active, float t_min, const float* lane_t_max);
+
+    std::vector<BVHNode> nodes;
+    std::vector<std::shared_ptr<Hittable>> primitives;
+    std::vector<HittableType> types;   // Per primitive, for Hit_primitive
+    AABB bounds;
+    float built_area = 0.0f;           // Summed node surface area of the fresh build
+};
+
+namespace BVHDetail
+{
+    inline float GetNodeArea(const BVHNode& node)
+    {
+        return AABB(Point3(node.bounds_min[0], node.bounds_min[1], node.bounds_min[2]),
+            Point3(node.bounds_max[0], node.bounds_max[1], node.bounds_max[2])).GetSurfaceArea();
+    }
+}
+
+inline BVH::BVH(const HittableList& list, int max_leaf_size)
+{
+    std::vector<BVHBuilder::Primitive> build_prims;
+    build_prims.reserve(list.objects.size());
+
+    for (uint32_t i = 0; i < list.objects.size(); ++i)
+    {
+        const AABB box = list.objects[i]->GetBoundingBox();
+        build_prims.push_back({ box, box.GetCentroid(), i });
+        bounds.Grow(box);
+    }
+
+    nodes = BVHBuilder::Build(build_prims, max_leaf_size);
+
+    primitives.reserve(build_prims.size());
+    types.reserve(build_prims.size());
+    for (const auto& prim : build_prims)
+    {
+        primitives.push_back(list.objects[prim.index]);
+        types.push_back(primitives.back()->GetType());
+    }
+
+    for (const BVHNode& node : nodes)
+    {
+        built_area += BVHDetail::GetNodeArea(node);
+    }
+}
+
+inline float BVH::Refit()
+{
+    // Children are stored after their parent, so one backward sweep sees every child first
+    float area = 0.0f;
+    for (size_t n = nodes.size(); n-- > 0;)
+    {
+        BVHNode& node = nodes[n];
+        AABB box;
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                box.Grow(primitives[i]->GetBoundingBox());
+            }
+        }
+        else
+        {
+            for (const BVHNode* child : { &nodes[n + 1], &nodes[node.offset] })
+            {
+                box.Grow(Point3(child->bounds_min[0], child->bounds_min[1], child->bounds_min[2]));
+                box.Grow(Point3(child->bounds_max[0], child->bounds_max[1], child->bounds_max[2]));
+            }
+        }
+        BVHBuilder::SetBounds(node, box);
+        area += BVHDetail::GetNodeArea(node);
+        if (n == 0)
+        {
+            bounds = box;
+        }
+    }
+    return built_area > 0.0f ? area / built_area : 1.0f;
+}
+
+inline bool BVH::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    return TraverseBVH(nodes.data(), r, t_min, t_max, [&](const BVHNode& node, float& closest_so_far)
+        {
+            bool hit = false;
+            for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+            {
+                if (Hit_primitive(types[i], *primitives[i], r, t_min, closest_so_far, rec))
+                {
+                    hit = true;
+                    closest_so_far = rec.t;
+                }
+            }
+            return hit;
+        });
+}
+
+inline uint32_t BVH::IntersectPacket(const BVHNode& node, const RayPacket& packet, uint32_t active, float t_min, const float* lane_t_max)
+{
+    // Same slab test as Hit, four lanes at a time. SSE2 is part of every x86-64 target.
+    uint32_t lanes = 0;
+
+#if defined(RT_X86)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 lo = _mm_set1_ps(t_min);
+    const float* origins[3] = { packet.origin_x, packet.origin_y, packet.origin_z };
+    const float* inv_dirs[3] = { packet.inv_direction_x, packet.inv_direction_y, packet.inv_direction_z };
+
+    for (int base = 0; base < RayPacket::size; base += 4)
+    {
+        __m128 t0 = lo;
+        __m128 t1 = _mm_loadu_ps(lane_t_max + base);
+
+        for (int a = 0; a < 3; ++a)
+        {
+            const __m128 o = _mm_load_ps(origins[a] + base);
+            const __m128 inv = _mm_load_ps(inv_dirs[a] + base);
+            const __m128 s0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds_min[a]), o), inv);
+            const __m128 s1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bounds_max[a]), o), inv);
+            const __m128 neg = _mm_cmplt_ps(inv, zero);
+            const __m128 t_near = _mm_or_ps(_mm_and_ps(neg, s1), _mm_andnot_ps(neg, s0));
+            const __m128 t_far = _mm_or_ps(_mm_and_ps(neg, s0), _mm_andnot_ps(neg, s1));
+            t0 = _mm_max_ps(t_near, t0);
+            t1 = _mm_min_ps(t_far, t1);
+        }
+
+        lanes |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(t0, t1))) << base;
+    }
+#else
+    for (int lane = 0; lane < RayPacket::size; ++lane)
+    {
+        const float o[3] = { packet.origin_x[lane], packet.origin_y[lane], packet.origin_z[lane] };
+        const float inv[3] = { packet.inv_direction_x[lane], packet.inv_direction_y[lane], packet.inv_direction_z[lane] };
+
+        float t0 = t_min;
+        float t1 = lane_t_max[lane];
+        for (int a = 0; a < 3; ++a)
+        {
+            float t_near = (node.bounds_min[a] - o[a]) * inv[a];
+            float t_far = (node.bounds_max[a] - o[a]) * inv[a];
+            if (inv[a] < 0)
+            {
+                std::swap(t_near, t_far);
+            }
+            t0 = t_near > t0 ? t_near : t0;
+            t1 = t_far < t1 ? t_far : t1;
+        }
+
+        lanes |= static_cast<uint32_t>(t0 <= t1) << lane;
+    }
+#endif
+
+    return lanes & active;
+}
+
+inline uint32_t BVH::HitPacket(const RayPacket& packet, uint32_t active, float t_min, float* lane_t_max, HitRecord* recs) const
+{
+    if (nodes.empty() || active == 0)
+    {
+        return 0;
+    }
+
+    // The packet is coherent, so the first active lane decides the child order for all
+    int first_lane = 0;
+    while (!(active & (1u << first_lane)))
+    {
+        ++first_lane;
+    }
+    const bool dir_is_neg[3] = {
+        packet.inv_direction_x[first_lane] < 0,
+        packet.inv_direction_y[first_lane] < 0,
+        packet.inv_direction_z[first_lane] < 0 };
+
+    uint32_t stack[BVHBuilder::stack_size];
+    int stack_top = 0;
+    uint32_t current = 0;
+    uint32_t hit_lanes = 0;
+
+    while (true)
+    {
+        const BVHNode& node = nodes[current];
+        RT_COUNT(++Counters::Local().bvh_nodes_visited);
+        const uint32_t node_lanes = IntersectPacket(node, packet, active, t_min, lane_t_max);
+
+        // A node is skipped only when every lane misses it
+        if (node_lanes != 0)
+        {
+            if (node.count > 0)
+            {
+                for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+                {
+                    hit_lanes |= Hit_primitive_packet(types[i], *primitives[i], packet, node_lanes, t_min, lane_t_max, recs);
+                }
+            }
+            else
+            {
+                if (dir_is_neg[node.axis])
+                {
+                    stack[stack_top++] = current + 1;
+                    current = node.offset;
+                }
+                else
+                {
+                    stack[stack_top++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stack_top == 0)
+        {
+            break;
+        }
+        current = stack[--stack_top];
+    }
+
+    return hit_lanes;
+}
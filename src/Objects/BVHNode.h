@@ -0,0 +1,284 @@
+#pragma once
+
+#include "AABB.h"
+#include "../Counters.h"
+#include "../Ray.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Flattened BVH node. Children of an interior node are stored at index + 1
+// and at offset, so a node fits in half a cache line.
+struct BVHNode
+{
+    float bounds_min[3];
+    uint32_t offset;     // First primitive of a leaf, second child of an interior node
+    float bounds_max[3];
+    uint16_t count;      // Number of primitives in a leaf, 0 for interior nodes
+    uint16_t axis;       // Split axis, used to visit the nearer child first
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode should stay 32 bytes");
+
+// Binned-SAH builder. Works on bounding boxes only, so any primitive store
+// can use it: the caller reorders its primitives by the returned order.
+class BVHBuilder
+{
+public:
+    struct Primitive
+    {
+        AABB box;
+        Point3 centroid;
+        uint32_t index;
+    };
+
+    static constexpr int stack_size = 64;   // Traversal stack depth the built trees stay within
+
+    static void SetBounds(BVHNode& node, const AABB& box);
+
+    // Reorders prims so that every leaf covers a contiguous range of them
+    static std::vector<BVHNode> Build(std::vector<Primitive>& prims, int max_leaf_size)
+    {
+        BVHBuilder builder(prims, max_leaf_size);
+        if (!prims.empty())
+        {
+            builder.nodes.reserve(2 * prims.size());
+            builder.Build(0, static_cast<uint32_t>(prims.size()), 0);
+            builder.nodes.shrink_to_fit();
+        }
+        return std::move(builder.nodes);
+    }
+
+private:
+    static constexpr int bin_count = 16;
+    static constexpr int max_sah_depth = 32;   // Below this depth splits fall back to the median
+    static constexpr float traversal_cost = 1.0f;
+
+    BVHBuilder(std::vector<Primitive>& _prims, int _max_leaf_size) : prims(_prims), max_leaf_size(_max_leaf_size)
+    {
+    }
+
+    uint32_t Build(uint32_t begin, uint32_t end, int depth);
+
+    std::vector<Primitive>& prims;
+    std::vector<BVHNode> nodes;
+    int max_leaf_size;
+};
+
+inline void BVHBuilder::SetBounds(BVHNode& node, const AABB& box)
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        node.bounds_min[a] = box.minimum[a];
+        node.bounds_max[a] = box.maximum[a];
+    }
+}
+
+inline uint32_t BVHBuilder::Build(uint32_t begin, uint32_t end, int depth)
+{
+    const uint32_t node_index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+
+    AABB box;
+    AABB centroid_box;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        box.Grow(prims[i].box);
+        centroid_box.Grow(prims[i].centroid);
+    }
+
+    const auto make_leaf = [&]()
+    {
+        BVHNode& node = nodes[node_index];
+        SetBounds(node, box);
+        node.offset = begin;
+        node.count = static_cast<uint16_t>(end - begin);
+        node.axis = 0;
+        return node_index;
+    };
+
+    const uint32_t count = end - begin;
+    if (count <= static_cast<uint32_t>(max_leaf_size))
+    {
+        return make_leaf();
+    }
+
+    // Binned SAH: evaluate bin_count - 1 split planes on every axis
+    int best_axis = -1;
+    int best_split = 0;
+    float best_cost = infinity;
+
+    for (int axis = 0; axis < 3 && depth < max_sah_depth; ++axis)
+    {
+        const float c_min = centroid_box.minimum[axis];
+        const float extent = centroid_box.maximum[axis] - c_min;
+        if (extent <= 0.0f)
+        {
+            continue;
+        }
+
+        AABB bin_boxes[bin_count];
+        uint32_t bin_counts[bin_count] = {};
+        const float scale = bin_count / extent;
+
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const int bin = std::min(static_cast<int>((prims[i].centroid[axis] - c_min) * scale), bin_count - 1);
+            bin_boxes[bin].Grow(prims[i].box);
+            bin_counts[bin]++;
+        }
+
+        float right_area[bin_count - 1];
+        uint32_t right_count[bin_count - 1];
+        AABB right_box;
+        uint32_t right_sum = 0;
+        for (int i = bin_count - 1; i > 0; --i)
+        {
+            right_box.Grow(bin_boxes[i]);
+            right_sum += bin_counts[i];
+            right_area[i - 1] = right_box.GetSurfaceArea();
+            right_count[i - 1] = right_sum;
+        }
+
+        AABB left_box;
+        uint32_t left_sum = 0;
+        for (int i = 0; i < bin_count - 1; ++i)
+        {
+            left_box.Grow(bin_boxes[i]);
+            left_sum += bin_counts[i];
+            if (left_sum == 0 || right_count[i] == 0)
+            {
+                continue;
+            }
+
+            const float cost = left_sum * left_box.GetSurfaceArea() + right_count[i] * right_area[i];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = i;
+            }
+        }
+    }
+
+    const float box_area = box.GetSurfaceArea();
+    const float leaf_cost = static_cast<float>(count);
+    const float split_cost = box_area > 0.0f ? traversal_cost + best_cost / box_area : infinity;
+
+    uint32_t mid = begin;
+    int split_axis = best_axis;
+
+    if (best_axis >= 0)
+    {
+        if (split_cost >= leaf_cost && count <= 4u * max_leaf_size)
+        {
+            return make_leaf();
+        }
+
+        const float c_min = centroid_box.minimum[best_axis];
+        const float scale = bin_count / (centroid_box.maximum[best_axis] - c_min);
+        const auto split_it = std::partition(prims.begin() + begin, prims.begin() + end,
+            [=](const Primitive& p)
+            {
+                const int bin = std::min(static_cast<int>((p.centroid[best_axis] - c_min) * scale), bin_count - 1);
+                return bin <= best_split;
+            });
+        mid = static_cast<uint32_t>(split_it - prims.begin());
+    }
+
+    if (mid == begin || mid == end)
+    {
+        // No useful SAH split (deep node or coincident centroids): split at the median
+        split_axis = centroid_box.GetLongestAxis();
+        mid = begin + count / 2;
+        std::nth_element(prims.begin() + begin, prims.begin() + mid, prims.begin() + end,
+            [=](const Primitive& a, const Primitive& b)
+            {
+                return a.centroid[split_axis] < b.centroid[split_axis];
+            });
+    }
+
+    Build(begin, mid, depth + 1);
+    const uint32_t right_child = Build(mid, end, depth + 1);
+
+    BVHNode& node = nodes[node_index];
+    SetBounds(node, box);
+    node.offset = right_child;
+    node.count = 0;
+    node.axis = static_cast<uint16_t>(split_axis);
+
+    return node_index;
+}
+
+// Closest-hit traversal of a flattened tree. hit_leaf(node, closest_so_far) tests
+// the primitives of a leaf, lowers closest_so_far on a hit and returns whether
+// it hit anything.
+template <typename LeafFunction>
+inline bool TraverseBVH(const BVHNode* nodes, const Ray& r, float t_min, float t_max, LeafFunction&& hit_leaf)
+{
+    const Vector3 origin = r.GetOrigin();
+    const Vector3 direction = r.GetDirection();
+    const float o[3] = { origin.x, origin.y, origin.z };
+    const float inv_dir[3] = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+    const bool dir_is_neg[3] = { inv_dir[0] < 0, inv_dir[1] < 0, inv_dir[2] < 0 };
+
+    uint32_t stack[BVHBuilder::stack_size];
+    int stack_top = 0;
+    uint32_t current = 0;
+
+    bool hit_anything = false;
+    float closest_so_far = t_max;
+
+    while (true)
+    {
+        const BVHNode& node = nodes[current];
+        RT_COUNT(++Counters::Local().bvh_nodes_visited);
+
+        float t0 = t_min;
+        float t1 = closest_so_far;
+        for (int a = 0; a < 3; ++a)
+        {
+            float t_near = (node.bounds_min[a] - o[a]) * inv_dir[a];
+            float t_far = (node.bounds_max[a] - o[a]) * inv_dir[a];
+            if (dir_is_neg[a])
+            {
+                std::swap(t_near, t_far);
+            }
+            t0 = t_near > t0 ? t_near : t0;
+            t1 = t_far < t1 ? t_far : t1;
+        }
+
+        if (t0 <= t1)
+        {
+            if (node.count > 0)
+            {
+                hit_anything |= hit_leaf(node, closest_so_far);
+            }
+            else
+            {
+                // Visit the child on the ray's side of the split first
+                if (dir_is_neg[node.axis])
+                {
+                    stack[stack_top++] = current + 1;
+                    current = node.offset;
+                }
+                else
+                {
+                    stack[stack_top++] = node.offset;
+                    current = current + 1;
+                }
+                continue;
+            }
+        }
+
+        if (stack_top == 0)
+        {
+            break;
+        }
+        current = stack[--stack_top];
+    }
+
+    return hit_anything;
+}
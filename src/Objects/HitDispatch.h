@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Hittable.h"
+#include "Instance.h"
+#include "Sphere.h"
+#include "SphereBVH.h"
+#include "SphereSet.h"
+#include "TriangleMesh.h"
+
+// Closed-set dispatch over the built-in primitives. The switch replaces the
+// virtual call, and since the built-in classes are final the call after the
+// cast is direct, so header-defined Hit functions (Sphere, Instance) inline
+// into the caller's leaf loop. Custom primitives still go through the vtable.
+
+template <typename T>
+inline uint32_t Hit_lanes(const T& object, const RayPacket& packet, uint32_t active, float t_min, float* lane_t_max, HitRecord* recs)
+{
+    uint32_t hit_lanes = 0;
+    for (int lane = 0; lane < RayPacket::size; ++lane)
+    {
+        if ((active & (1u << lane)) && object.Hit(packet.GetRay(lane), t_min, lane_t_max[lane], recs[lane]))
+        {
+            lane_t_max[lane] = recs[lane].t;
+            hit_lanes |= 1u << lane;
+        }
+    }
+    return hit_lanes;
+}
+
+inline bool Hit_primitive(HittableType type, const Hittable& object, const Ray& r, float t_min, float t_max, HitRecord& rec)
+{
+    switch (type)
+    {
+    case HittableType::Sphere: return static_cast<const Sphere&>(object).Hit(r, t_min, t_max, rec);
+    case HittableType::SphereSet: return static_cast<const SphereSet&>(object).Hit(r, t_min, t_max, rec);
+    case HittableType::SphereBVH: return static_cast<const SphereBVH&>(object).Hit(r, t_min, t_max, rec);
+    case HittableType::TriangleMesh: return static_cast<const TriangleMesh&>(object).Hit(r, t_min, t_max, rec);
+    case HittableType::Instance: return static_cast<const Instance&>(object).Hit(r, t_min, t_max, rec);
+    default: return object.Hit(r, t_min, t_max, rec);
+    }
+}
+
+// None of the built-in primitives has a packet kernel, so they are tested lane
+// by lane; the switch is taken once per packet rather than once per lane
+inline uint32_t Hit_primitive_packet(HittableType type, const Hittable& object, const RayPacket& packet, uint32_t active, float t_min, float* lane_t_max, HitRecord* recs)
+{
+    switch (type)
+    {
+    case HittableType::Sphere: return Hit_lanes(static_cast<const Sphere&>(object), packet, active, t_min, lane_t_max, recs);
+    case HittableType::SphereSet: return Hit_lanes(static_cast<const SphereSet&>(object), packet, active, t_min, lane_t_max, recs);
+    case HittableType::SphereBVH: return Hit_lanes(static_cast<const SphereBVH&>(object), packet, active, t_min, lane_t_max, recs);
+    case HittableType::TriangleMesh: return Hit_lanes(static_cast<const TriangleMesh&>(object), packet, active, t_min, lane_t_max, recs);
+    case HittableType::Instance: return Hit_lanes(static_cast<const Instance&>(object), packet, active, t_min, lane_t_max, recs);
+    default: return object.HitPacket(packet, active, t_min, lane_t_max, recs);
+    }
+}
@@ -1,14 +1,18 @@
 #pragma once
 
 #include "../Ray.h"
+#include "../RayPacket.h"
+#include "AABB.h"
 
-class Material;
+#include <cstdint>
+
+using MaterialId = uint32_t;   // Index into the scene's MaterialTable
 
 struct HitRecord
 {
     Point3 p;
     Vector3 normal;
-    std::shared_ptr<Material> mat_ptr;
+    MaterialId mat_id = 0;
     float t;
     bool front_face = false;
 
@@ -19,9 +23,43 @@ struct HitRecord
     }
 };
 
+// Tag for the built-in primitives, so the BVH can dispatch without a virtual call
+enum class HittableType : uint8_t
+{
+    Sphere,
+    SphereSet,
+    SphereBVH,
+    TriangleMesh,
+    Instance,
+    Custom
+};
+
 class Hittable
 {
 public:
     virtual ~Hittable() = default;
     virtual bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const = 0;
+    virtual AABB GetBoundingBox() const = 0;
+
+    // The built-in final classes return their own tag; everything else is Custom
+    virtual HittableType GetType() const
+    {
+        return HittableType::Custom;
+    }
+
+    // Intersects the lanes set in active. lane_t_max holds each lane's closest hit so far
+    // and is tightened on success. Returns the lanes that found a closer hit.
+    virtual uint32_t HitPacket(const RayPacket& packet, uint32_t active, float t_min, float* lane_t_max, HitRecord* recs) const
+    {
+        uint32_t hit_lanes = 0;
+        for (int lane = 0; lane < RayPacket::size; ++lane)
+        {
+            if ((active & (1u << lane)) && Hit(packet.GetRay(lane), t_min, lane_t_max[lane], recs[lane]))
+            {
+                lane_t_max[lane] = recs[lane].t;
+                hit_lanes |= 1u << lane;
+            }
+        }
+        return hit_lanes;
+    }
 };
\ No newline at end of file
@@ -28,22 +28,41 @@ public:
 
     bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const override;
 
+    uint32_t HitPacket(const RayPacket& packet, uint32_t active, float t_min, float* lane_t_max, HitRecord* recs) const override
+    {
+        uint32_t hit_lanes = 0;
+        for (const auto& object : objects)
+        {
+            hit_lanes |= object->HitPacket(packet, active, t_min, lane_t_max, recs);
+        }
+        return hit_lanes;
+    }
+
+    AABB GetBoundingBox() const override
+    {
+        AABB box;
+        for (const auto& object : objects)
+        {
+            box.Grow(object->GetBoundingBox());
+        }
+        return box;
+    }
+
     std::vector<std::shared_ptr<Hittable>> objects;
 };
 
 inline bool HittableList::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
 {
-    HitRecord temp_rec;
     bool hit_anything = false;
     auto closest_so_far = t_max;
 
+    // Hit only writes rec when it finds a closer hit, so no temporary record is needed
     for (const auto& object : objects)
     {
-        if (object->Hit(r, t_min, closest_so_far, temp_rec))
+        if (object->Hit(r, t_min, closest_so_far, rec))
         {
             hit_anything = true;
-            closest_so_far = temp_rec.t;
-            rec = temp_rec;
+            closest_so_far = rec.t;
         }
     }
 
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Hittable.h"
+#include "../Transform.h"
+
+#include <memory>
+#include <optional>
+#include <utility>
+
+// Shared geometry placed in the scene by an affine transform. Rays are moved
+// into object space rather than the geometry into world space, so any number
+// of instances share one copy of the geometry and its acceleration structure.
+class Instance final : public Hittable
+{
+public:
+    static constexpr HittableType type = HittableType::Instance;
+
+    // material, if given, replaces the materials of the geometry
+    Instance(std::shared_ptr<const Hittable> _geometry, const Transform& object_to_world, std::optional<MaterialId> _material = std::nullopt);
+
+    // Moves the instance, as animations do between frames. A BVH over the
+    // instance must be refit or rebuilt before it is traced again.
+    void SetTransform(const Transform& object_to_world);
+
+    bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const override;
+
+    AABB GetBoundingBox() const override
+    {
+        return bounds;
+    }
+
+    HittableType GetType() const override
+    {
+        return type;
+    }
+
+private:
+    // Only the inverse is kept: hit points are taken on the world ray, and
+    // normals need the inverse transposed
+    std::shared_ptr<const Hittable> geometry;
+    Transform world_to_object;
+    AABB bounds;
+    std::optional<MaterialId> material;
+};
+
+inline Instance::Instance(std::shared_ptr<const Hittable> _geometry, const Transform& object_to_world, std::optional<MaterialId> _material)
+    : geometry(std::move(_geometry)), material(_material)
+{
+    SetTransform(object_to_world);
+}
+
+inline void Instance::SetTransform(const Transform& object_to_world)
+{
+    world_to_object = object_to_world.GetInverse();
+    bounds = AABB();
+    const AABB box = geometry->GetBoundingBox();
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const Point3 p(
+            corner & 1 ? box.maximum.x : box.minimum.x,
+            corner & 2 ? box.maximum.y : box.minimum.y,
+            corner & 4 ? box.maximum.z : box.minimum.z);
+        bounds.Grow(object_to_world.ApplyToPoint(p));
+    }
+}
+
+inline bool Instance::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
+{
+    // The object-space direction is not renormalized, so t means the same on both rays
+    const Ray local(world_to_object.ApplyToPoint(r.GetOrigin()), world_to_object.ApplyToVector(r.GetDirection()));
+    if (!geometry->Hit(local, t_min, t_max, rec))
+    {
+        return false;
+    }
+
+    // The facing test carries over: dot(d, inverse-transpose n) == dot(local d, n)
+    rec.p = r.GetCoordinateAt(rec.t);
+    rec.normal = world_to_object.ApplyTransposeToVector(rec.normal).GetNormalized();
+    if (material)
+    {
+        rec.mat_id = *material;
+    }
+
+    return true;
+}
@@ -1,26 +1,42 @@
 #pragma once
 #include "Hittable.h"
+#include "../Counters.h"
 
-class Sphere : public Hittable
+class Sphere final : public Hittable
 {
 public:
+    static constexpr HittableType type = HittableType::Sphere;
+
     Sphere() = default;
 
-    Sphere(Point3 cen, float r, std::shared_ptr<Material> m)
-        : center(cen), radius(r), mat_ptr(m)
+    Sphere(Point3 cen, float r, MaterialId m)
+        : center(cen), radius(r), mat_id(m)
     {
     }
 
     bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const override;
 
+    AABB GetBoundingBox() const override
+    {
+        const Vector3 extent(radius, radius, radius);
+        return AABB(center - extent, center + extent);
+    }
+
+    HittableType GetType() const override
+    {
+        return type;
+    }
+
 private:
     Point3 center;
     float radius = 0.0f;
-    std::shared_ptr<Material> mat_ptr;
+    MaterialId mat_id = 0;
 };
 
-bool Sphere::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
+inline bool Sphere::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
 {
+    RT_COUNT(++Counters::Local().primitive_tests);
+
     const Vector3 oc = r.GetOrigin() - center;
     const auto a = r.GetDirection().GetSquaredLength();
     const auto half_b = Vector3::Dot(oc, r.GetDirection());
@@ -39,7 +55,8 @@ bool Sphere::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
 
             const Vector3 outward_normal = (rec.p - center) / radius;
             rec.set_face_normal(r, outward_normal);
-            rec.mat_ptr = mat_ptr;
+            rec.mat_id = mat_id;
+            RT_COUNT(++Counters::Local().primitive_hits);
 
             return true;
         }
@@ -53,7 +70,8 @@ bool Sphere::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
 
             const Vector3 outward_normal = (rec.p - center) / radius;
             rec.set_face_normal(r, outward_normal);
-            rec.mat_ptr = mat_ptr;
+            rec.mat_id = mat_id;
+            RT_COUNT(++Counters::Local().primitive_hits);
 
             return true;
         }
@@ -0,0 +1,104 @@
+#include "SphereBVH.h"
+#include "../Counters.h"
+
+#include <limits>
+#include <utility>
+
+SphereBVH::SphereBVH(const SphereBVHView& _view, std::shared_ptr<const void> _owner)
+    : view(_view), owner(std::move(_owner)), kernel(SelectSphereHitKernel(ActiveSimdLevel()))
+{
+    if (view.node_count > 0)
+    {
+        const BVHNode& root = view.nodes[0];
+        bounds = AABB(Point3(root.bounds_min[0], root.bounds_min[1], root.bounds_min[2]),
+            Point3(root.bounds_max[0], root.bounds_max[1], root.bounds_max[2]));
+    }
+}
+
+bool SphereBVH::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
+{
+    if (view.node_count == 0)
+    {
+        return false;
+    }
+
+    int closest = -1;
+    float closest_t = t_max;
+    TraverseBVH(view.nodes, r, t_min, t_max, [&](const BVHNode& node, float& closest_so_far)
+        {
+            float t;
+            const int index = kernel(view.spheres, node.offset, node.offset + node.count, r, t_min, closest_so_far, t);
+            RT_COUNT(Counters::Local().primitive_tests += node.count);
+            if (index < 0)
+            {
+                return false;
+            }
+            closest = index;
+            closest_so_far = closest_t = t;
+            return true;
+        });
+
+    if (closest < 0)
+    {
+        return false;
+    }
+
+    // The record is filled in once for the closest sphere, not for every leaf hit on the way
+    RT_COUNT(++Counters::Local().primitive_hits);
+    const SphereArrays& s = view.spheres;
+    const Point3 center(s.center_x[closest], s.center_y[closest], s.center_z[closest]);
+    rec.t = closest_t;
+    rec.p = r.GetCoordinateAt(closest_t);
+
+    const Vector3 outward_normal = (rec.p - center) / s.radius[closest];
+    rec.set_face_normal(r, outward_normal);
+    rec.mat_id = view.mat_ids[closest];
+
+    return true;
+}
+
+std::shared_ptr<SphereBVHData> SphereBVHData::Build(const std::vector<InputSphere>& spheres)
+{
+    std::vector<BVHBuilder::Primitive> build_prims;
+    build_prims.reserve(spheres.size());
+    for (uint32_t i = 0; i < spheres.size(); ++i)
+    {
+        const Vector3 extent(spheres[i].radius, spheres[i].radius, spheres[i].radius);
+        const AABB box(spheres[i].center - extent, spheres[i].center + extent);
+        build_prims.push_back({ box, spheres[i].center, i });
+    }
+
+    auto data = std::make_shared<SphereBVHData>();
+    data->nodes = BVHBuilder::Build(build_prims, max_leaf_size);
+    data->count = static_cast<uint32_t>(spheres.size());
+
+    // Store the spheres in leaf order so every leaf is a contiguous range
+    const size_t padded = spheres.size() + SphereSet::lane_padding;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    data->center_x.assign(padded, nan);
+    data->center_y.assign(padded, nan);
+    data->center_z.assign(padded, nan);
+    data->radius.assign(padded, 0.0f);
+    data->mat_ids.assign(padded, 0);
+    for (size_t i = 0; i < build_prims.size(); ++i)
+    {
+        const InputSphere& sphere = spheres[build_prims[i].index];
+        data->center_x[i] = sphere.center.x;
+        data->center_y[i] = sphere.center.y;
+        data->center_z[i] = sphere.center.z;
+        data->radius[i] = sphere.radius;
+        data->mat_ids[i] = sphere.mat_id;
+    }
+
+    return data;
+}
+
+SphereBVHView SphereBVHData::GetView() const
+{
+    return {
+        nodes.data(),
+        static_cast<uint32_t>(nodes.size()),
+        { center_x.data(), center_y.data(), center_z.data(), radius.data() },
+        mat_ids.data(),
+        count };
+}
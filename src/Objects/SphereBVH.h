@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BVHNode.h"
+#include "Hittable.h"
+#include "SphereSet.h"
+#include "../AlignedAllocator.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Read-only sphere data in BVH leaf order together with the tree over it. Every
+// pointer may point straight into a mapped scene file.
+struct SphereBVHView
+{
+    const BVHNode* nodes;
+    uint32_t node_count;
+    SphereArrays spheres;
+    const MaterialId* mat_ids;
+    uint32_t sphere_count;
+};
+
+// Spheres with the BVH built directly over them: leaves are ranges of the
+// sphere arrays, tested with the SphereSet SIMD kernels. Scales to millions of
+// spheres without one object per sphere, and does not own its data: owner keeps
+// whatever backs the view (a mapped file or SphereBVHData) alive.
+class SphereBVH final : public Hittable
+{
+public:
+    static constexpr HittableType type = HittableType::SphereBVH;
+
+    SphereBVH(const SphereBVHView& _view, std::shared_ptr<const void> _owner);
+
+    bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const override;
+
+    AABB GetBoundingBox() const override
+    {
+        return bounds;
+    }
+
+    HittableType GetType() const override
+    {
+        return type;
+    }
+
+private:
+    SphereBVHView view;
+    std::shared_ptr<const void> owner;
+    AABB bounds;
+    SphereHitKernel kernel;
+};
+
+// In-memory storage for a SphereBVH, built from loose spheres
+struct SphereBVHData
+{
+    static constexpr int max_leaf_size = 8;   // One AVX2 kernel step per leaf
+
+    struct InputSphere
+    {
+        Point3 center;
+        float radius;
+        MaterialId mat_id;
+    };
+
+    static std::shared_ptr<SphereBVHData> Build(const std::vector<InputSphere>& spheres);
+
+    SphereBVHView GetView() const;
+
+    std::vector<BVHNode> nodes;
+    // Padded by SphereSet::lane_padding entries for the kernels' full-width loads
+    AlignedVector<float> center_x;
+    AlignedVector<float> center_y;
+    AlignedVector<float> center_z;
+    AlignedVector<float> radius;
+    AlignedVector<MaterialId> mat_ids;
+    uint32_t count = 0;
+};
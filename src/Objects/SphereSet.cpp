@@ -0,0 +1,286 @@
+#include "SphereSet.h"
+#include "../Counters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(RT_X86)
+#include <immintrin.h>
+#endif
+
+struct SphereSetKernels
+{
+    static int HitScalar(const SphereArrays& set, uint32_t begin, uint32_t end, const Ray& r, float t_min, float t_max, float& t)
+    {
+        const Vector3 origin = r.GetOrigin();
+        const Vector3 direction = r.GetDirection();
+        const float a = direction.GetSquaredLength();
+
+        int closest = -1;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const Vector3 oc = origin - Vector3(set.center_x[i], set.center_y[i], set.center_z[i]);
+            const float half_b = Vector3::Dot(oc, direction);
+            const float c = oc.GetSquaredLength() - set.radius[i] * set.radius[i];
+            const float discriminant = half_b * half_b - a * c;
+
+            if (discriminant > 0)
+            {
+                const float root = std::sqrt(discriminant);
+                float temp = (-half_b - root) / a;
+                if (!(temp < t_max && temp > t_min))
+                {
+                    temp = (-half_b + root) / a;
+                }
+                if (temp < t_max && temp > t_min)
+                {
+                    t_max = temp;
+                    closest = static_cast<int>(i);
+                }
+            }
+        }
+
+        t = t_max;
+        return closest;
+    }
+
+#if defined(RT_X86)
+    RT_TARGET("avx2,fma")
+    static int HitAvx2(const SphereArrays& set, uint32_t begin, uint32_t end, const Ray& r, float t_min, float t_max, float& t)
+    {
+        const Vector3 origin = r.GetOrigin();
+        const Vector3 direction = r.GetDirection();
+
+        const __m256 ox = _mm256_set1_ps(origin.x);
+        const __m256 oy = _mm256_set1_ps(origin.y);
+        const __m256 oz = _mm256_set1_ps(origin.z);
+        const __m256 dx = _mm256_set1_ps(direction.x);
+        const __m256 dy = _mm256_set1_ps(direction.y);
+        const __m256 dz = _mm256_set1_ps(direction.z);
+        const __m256 a = _mm256_set1_ps(direction.GetSquaredLength());
+        const __m256 t_lo = _mm256_set1_ps(t_min);
+        const __m256 zero = _mm256_setzero_ps();
+
+        __m256 best_t = _mm256_set1_ps(t_max);
+        __m256i best_index = _mm256_set1_epi32(-1);
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(begin)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        const __m256i step = _mm256_set1_epi32(8);
+        const __m256i end_index = _mm256_set1_epi32(static_cast<int>(end));
+
+        for (uint32_t i = begin; i < end; i += 8)
+        {
+            const __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(set.center_x + i));
+            const __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(set.center_y + i));
+            const __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(set.center_z + i));
+            const __m256 rad = _mm256_loadu_ps(set.radius + i);
+
+            const __m256 half_b = _mm256_fmadd_ps(ocx, dx, _mm256_fmadd_ps(ocy, dy, _mm256_mul_ps(ocz, dz)));
+            const __m256 oc_len = _mm256_fmadd_ps(ocx, ocx, _mm256_fmadd_ps(ocy, ocy, _mm256_mul_ps(ocz, ocz)));
+            const __m256 c = _mm256_fnmadd_ps(rad, rad, oc_len);
+            const __m256 discriminant = _mm256_fnmadd_ps(a, c, _mm256_mul_ps(half_b, half_b));
+            // Lanes past the end of the range belong to other spheres or to padding
+            const __m256 in_range = _mm256_castsi256_ps(_mm256_cmpgt_epi32(end_index, index));
+            const __m256 has_roots = _mm256_and_ps(in_range, _mm256_cmp_ps(discriminant, zero, _CMP_GT_OQ));
+
+            if (_mm256_movemask_ps(has_roots) != 0)
+            {
+                const __m256 root = _mm256_sqrt_ps(discriminant);
+                const __m256 t_near = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, half_b), root), a);
+                const __m256 t_far = _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(zero, half_b), root), a);
+
+                const __m256 near_ok = _mm256_and_ps(_mm256_cmp_ps(t_near, t_lo, _CMP_GT_OQ), _mm256_cmp_ps(t_near, best_t, _CMP_LT_OQ));
+                const __m256 far_ok = _mm256_and_ps(_mm256_cmp_ps(t_far, t_lo, _CMP_GT_OQ), _mm256_cmp_ps(t_far, best_t, _CMP_LT_OQ));
+                const __m256 candidate = _mm256_blendv_ps(t_far, t_near, near_ok);
+                const __m256 accept = _mm256_and_ps(has_roots, _mm256_or_ps(near_ok, far_ok));
+
+                best_t = _mm256_blendv_ps(best_t, candidate, accept);
+                best_index = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_index), _mm256_castsi256_ps(index), accept));
+            }
+
+            index = _mm256_add_epi32(index, step);
+        }
+
+        // Min-reduce t across lanes, then take the first lane holding it
+        __m256 min_t = _mm256_min_ps(best_t, _mm256_permute2f128_ps(best_t, best_t, 1));
+        min_t = _mm256_min_ps(min_t, _mm256_shuffle_ps(min_t, min_t, _MM_SHUFFLE(1, 0, 3, 2)));
+        min_t = _mm256_min_ps(min_t, _mm256_shuffle_ps(min_t, min_t, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        const __m256 found = _mm256_andnot_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(best_index, _mm256_set1_epi32(-1))),
+            _mm256_cmp_ps(best_t, min_t, _CMP_EQ_OQ));
+        const int lanes = _mm256_movemask_ps(found);
+        if (lanes == 0)
+        {
+            t = t_max;
+            return -1;
+        }
+
+        alignas(32) int indices[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(indices), best_index);
+        t = _mm_cvtss_f32(_mm256_castps256_ps128(min_t));
+
+        int lane = 0;
+        while (!(lanes & (1 << lane)))
+        {
+            ++lane;
+        }
+        return indices[lane];
+    }
+
+    RT_TARGET("avx512f")
+    static int HitAvx512(const SphereArrays& set, uint32_t begin, uint32_t end, const Ray& r, float t_min, float t_max, float& t)
+    {
+        const Vector3 origin = r.GetOrigin();
+        const Vector3 direction = r.GetDirection();
+
+        const __m512 ox = _mm512_set1_ps(origin.x);
+        const __m512 oy = _mm512_set1_ps(origin.y);
+        const __m512 oz = _mm512_set1_ps(origin.z);
+        const __m512 dx = _mm512_set1_ps(direction.x);
+        const __m512 dy = _mm512_set1_ps(direction.y);
+        const __m512 dz = _mm512_set1_ps(direction.z);
+        const __m512 a = _mm512_set1_ps(direction.GetSquaredLength());
+        const __m512 t_lo = _mm512_set1_ps(t_min);
+        const __m512 zero = _mm512_setzero_ps();
+
+        __m512 best_t = _mm512_set1_ps(t_max);
+        __m512i best_index = _mm512_set1_epi32(-1);
+        __m512i index = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(begin)), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        const __m512i step = _mm512_set1_epi32(16);
+        const __m512i end_index = _mm512_set1_epi32(static_cast<int>(end));
+
+        for (uint32_t i = begin; i < end; i += 16)
+        {
+            const __m512 ocx = _mm512_sub_ps(ox, _mm512_loadu_ps(set.center_x + i));
+            const __m512 ocy = _mm512_sub_ps(oy, _mm512_loadu_ps(set.center_y + i));
+            const __m512 ocz = _mm512_sub_ps(oz, _mm512_loadu_ps(set.center_z + i));
+            const __m512 rad = _mm512_loadu_ps(set.radius + i);
+
+            const __m512 half_b = _mm512_fmadd_ps(ocx, dx, _mm512_fmadd_ps(ocy, dy, _mm512_mul_ps(ocz, dz)));
+            const __m512 oc_len = _mm512_fmadd_ps(ocx, ocx, _mm512_fmadd_ps(ocy, ocy, _mm512_mul_ps(ocz, ocz)));
+            const __m512 c = _mm512_fnmadd_ps(rad, rad, oc_len);
+            const __m512 discriminant = _mm512_fnmadd_ps(a, c, _mm512_mul_ps(half_b, half_b));
+            // Lanes past the end of the range belong to other spheres or to padding
+            const __mmask16 in_range = _mm512_cmplt_epi32_mask(index, end_index);
+            const __mmask16 has_roots = _mm512_mask_cmp_ps_mask(in_range, discriminant, zero, _CMP_GT_OQ);
+
+            if (has_roots != 0)
+            {
+                const __m512 root = _mm512_maskz_sqrt_ps(0xffff, discriminant);
+                const __m512 t_near = _mm512_div_ps(_mm512_sub_ps(_mm512_sub_ps(zero, half_b), root), a);
+                const __m512 t_far = _mm512_div_ps(_mm512_add_ps(_mm512_sub_ps(zero, half_b), root), a);
+
+                const __mmask16 near_ok = _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(t_near, t_lo, _CMP_GT_OQ), t_near, best_t, _CMP_LT_OQ);
+                const __mmask16 far_ok = _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(t_far, t_lo, _CMP_GT_OQ), t_far, best_t, _CMP_LT_OQ);
+                const __m512 candidate = _mm512_mask_blend_ps(near_ok, t_far, t_near);
+                const __mmask16 accept = has_roots & (near_ok | far_ok);
+
+                best_t = _mm512_mask_blend_ps(accept, best_t, candidate);
+                best_index = _mm512_mask_blend_epi32(accept, best_index, index);
+            }
+
+            index = _mm512_add_epi32(index, step);
+        }
+
+        const __mmask16 valid = _mm512_cmpneq_epi32_mask(best_index, _mm512_set1_epi32(-1));
+        if (valid == 0)
+        {
+            t = t_max;
+            return -1;
+        }
+
+        // Reduced through memory: GCC's reduce and sqrt intrinsics start from
+        // _mm512_undefined_ps, which -Wmaybe-uninitialized flags
+        alignas(64) float lane_t[16];
+        _mm512_store_ps(lane_t, _mm512_mask_blend_ps(valid, _mm512_set1_ps(infinity), best_t));
+        float min_t = lane_t[0];
+        for (int lane = 1; lane < 16; ++lane)
+        {
+            min_t = std::min(min_t, lane_t[lane]);
+        }
+        const __mmask16 found = _mm512_mask_cmp_ps_mask(valid, best_t, _mm512_set1_ps(min_t), _CMP_EQ_OQ);
+
+        alignas(64) int indices[16];
+        _mm512_store_si512(indices, best_index);
+        t = min_t;
+
+        int lane = 0;
+        while (!(found & (1 << lane)))
+        {
+            ++lane;
+        }
+        return indices[lane];
+    }
+#endif
+
+    static SphereHitKernel Select(SimdLevel level)
+    {
+#if defined(RT_X86)
+        switch (level)
+        {
+        case SimdLevel::AVX512: return &HitAvx512;
+        case SimdLevel::AVX2: return &HitAvx2;
+        default: break;
+        }
+#endif
+        return &HitScalar;
+    }
+};
+
+SphereHitKernel SelectSphereHitKernel(SimdLevel level)
+{
+    return SphereSetKernels::Select(level);
+}
+
+SphereSet::SphereSet() : kernel(SelectSphereHitKernel(ActiveSimdLevel()))
+{
+}
+
+void SphereSet::Add(const Point3& center, float r, MaterialId mat_id)
+{
+    if (count == center_x.size())
+    {
+        // The kernels mask out lanes past count, but they still load a full vector
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const size_t padded = count + lane_padding;
+        center_x.resize(padded, nan);
+        center_y.resize(padded, nan);
+        center_z.resize(padded, nan);
+        radius.resize(padded, 0.0f);
+        mat_ids.resize(padded, 0);
+    }
+
+    center_x[count] = center.x;
+    center_y[count] = center.y;
+    center_z[count] = center.z;
+    radius[count] = r;
+    mat_ids[count] = mat_id;
+    ++count;
+
+    const Vector3 extent(r, r, r);
+    bounds.Grow(AABB(center - extent, center + extent));
+}
+
+bool SphereSet::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
+{
+    float t;
+    const SphereArrays arrays = { center_x.data(), center_y.data(), center_z.data(), radius.data() };
+    const int index = kernel(arrays, 0, static_cast<uint32_t>(count), r, t_min, t_max, t);
+    RT_COUNT(Counters::Local().primitive_tests += count);
+    if (index < 0)
+    {
+        return false;
+    }
+    RT_COUNT(++Counters::Local().primitive_hits);
+
+    const Point3 center(center_x[index], center_y[index], center_z[index]);
+    rec.t = t;
+    rec.p = r.GetCoordinateAt(t);
+
+    const Vector3 outward_normal = (rec.p - center) / radius[index];
+    rec.set_face_normal(r, outward_normal);
+    rec.mat_id = mat_ids[index];
+
+    return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Hittable.h"
+#include "../AlignedAllocator.h"
+#include "../CpuFeatures.h"
+
+#include <cstdint>
+
+// Sphere data in structure-of-arrays form. The kernels load whole vectors, so
+// each array must stay readable for SphereSet::lane_padding entries past the last sphere.
+struct SphereArrays
+{
+    const float* center_x;
+    const float* center_y;
+    const float* center_z;
+    const float* radius;
+};
+
+// Returns the index of the closest sphere in [begin, end) with t in
+// (t_min, t_max) and stores its t, or returns -1.
+using SphereHitKernel = int (*)(const SphereArrays& spheres, uint32_t begin, uint32_t end, const Ray& r, float t_min, float t_max, float& t);
+
+// The widest kernel the given SIMD level can run
+SphereHitKernel SelectSphereHitKernel(SimdLevel level);
+
+// Packed spheres in structure-of-arrays form. One Hit call tests the ray
+// against 8 (AVX2) or 16 (AVX-512) spheres per instruction; the kernel is
+// picked from the CPU features when the set is created.
+class SphereSet final : public Hittable
+{
+public:
+    static constexpr HittableType type = HittableType::SphereSet;
+
+    static constexpr uint32_t lane_padding = 16;   // Arrays are padded to a multiple of the widest kernel
+
+    SphereSet();
+
+    void Add(const Point3& center, float radius, MaterialId mat_id);
+
+    bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const override;
+
+    AABB GetBoundingBox() const override
+    {
+        return bounds;
+    }
+
+    HittableType GetType() const override
+    {
+        return type;
+    }
+
+    size_t GetSize() const
+    {
+        return count;
+    }
+
+private:
+    AlignedVector<float> center_x;
+    AlignedVector<float> center_y;
+    AlignedVector<float> center_z;
+    AlignedVector<float> radius;
+    AlignedVector<MaterialId> mat_ids;
+    size_t count = 0;
+    AABB bounds;
+    SphereHitKernel kernel;
+};
@@ -0,0 +1,162 @@
+#include "TriangleMesh.h"
+#include "../Counters.h"
+
+#include <cmath>
+#include <utility>
+
+namespace
+{
+    // Watertight ray/triangle test (Woop, Benthin and Wald 2013). The ray is
+    // turned into the +z axis of a sheared space once per ray, and the edge
+    // functions are then evaluated on values that neighbouring triangles share
+    // exactly, so rays cannot slip through the edges between them.
+    struct WatertightRay
+    {
+        explicit WatertightRay(const Ray& r)
+        {
+            const Vector3 origin = r.GetOrigin();
+            const Vector3 direction = r.GetDirection();
+            o[0] = origin.x;
+            o[1] = origin.y;
+            o[2] = origin.z;
+            const float d[3] = { direction.x, direction.y, direction.z };
+
+            kz = 0;
+            if (std::fabs(d[1]) > std::fabs(d[kz])) kz = 1;
+            if (std::fabs(d[2]) > std::fabs(d[kz])) kz = 2;
+            kx = kz == 2 ? 0 : kz + 1;
+            ky = kx == 2 ? 0 : kx + 1;
+            if (d[kz] < 0.0f)
+            {
+                std::swap(kx, ky);   // Keeps the winding, so the sign tests stay valid
+            }
+
+            sx = d[kx] / d[kz];
+            sy = d[ky] / d[kz];
+            sz = 1.0f / d[kz];
+        }
+
+        bool Intersect(const float* a, const float* b, const float* c, float t_min, float t_max, float& t) const
+        {
+            const float ax = a[kx] - o[kx], ay = a[ky] - o[ky], az = a[kz] - o[kz];
+            const float bx = b[kx] - o[kx], by = b[ky] - o[ky], bz = b[kz] - o[kz];
+            const float cx = c[kx] - o[kx], cy = c[ky] - o[ky], cz = c[kz] - o[kz];
+
+            const float shear_ax = ax - sx * az, shear_ay = ay - sy * az;
+            const float shear_bx = bx - sx * bz, shear_by = by - sy * bz;
+            const float shear_cx = cx - sx * cz, shear_cy = cy - sy * cz;
+
+            float u = shear_cx * shear_by - shear_cy * shear_bx;
+            float v = shear_ax * shear_cy - shear_ay * shear_cx;
+            float w = shear_bx * shear_ay - shear_by * shear_ax;
+
+            // An edge function of exactly zero is redone in double so that the
+            // ray is assigned to exactly one of the triangles sharing the edge
+            if (u == 0.0f || v == 0.0f || w == 0.0f)
+            {
+                u = static_cast<float>(static_cast<double>(shear_cx) * shear_by - static_cast<double>(shear_cy) * shear_bx);
+                v = static_cast<float>(static_cast<double>(shear_ax) * shear_cy - static_cast<double>(shear_ay) * shear_cx);
+                w = static_cast<float>(static_cast<double>(shear_bx) * shear_ay - static_cast<double>(shear_by) * shear_ax);
+            }
+
+            if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+            {
+                return false;
+            }
+
+            const float det = u + v + w;
+            if (det == 0.0f)
+            {
+                return false;
+            }
+
+            const float scaled_t = u * sz * az + v * sz * bz + w * sz * cz;
+            t = scaled_t / det;
+            return t > t_min && t < t_max;
+        }
+
+        float o[3];
+        int kx, ky, kz;
+        float sx, sy, sz;
+    };
+}
+
+TriangleMesh::TriangleMesh(std::vector<float>&& _positions, std::vector<uint32_t>&& _indices, MaterialId _mat_id)
+    : positions(std::move(_positions)), indices(std::move(_indices)), mat_id(_mat_id)
+{
+    const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+    indices.resize(3 * static_cast<size_t>(triangle_count));
+
+    std::vector<BVHBuilder::Primitive> build_prims;
+    build_prims.reserve(triangle_count);
+    for (uint32_t i = 0; i < triangle_count; ++i)
+    {
+        AABB box;
+        box.Grow(GetVertex(indices[3 * i]));
+        box.Grow(GetVertex(indices[3 * i + 1]));
+        box.Grow(GetVertex(indices[3 * i + 2]));
+        build_prims.push_back({ box, box.GetCentroid(), i });
+        bounds.Grow(box);
+    }
+
+    nodes = BVHBuilder::Build(build_prims, max_leaf_size);
+
+    // Store the triangles in leaf order so every leaf is a contiguous index range
+    std::vector<uint32_t> leaf_order(indices.size());
+    for (size_t i = 0; i < build_prims.size(); ++i)
+    {
+        const size_t source = 3 * static_cast<size_t>(build_prims[i].index);
+        leaf_order[3 * i] = indices[source];
+        leaf_order[3 * i + 1] = indices[source + 1];
+        leaf_order[3 * i + 2] = indices[source + 2];
+    }
+    indices = std::move(leaf_order);
+}
+
+bool TriangleMesh::Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    const WatertightRay ray(r);
+    const float* vertices = positions.data();
+    size_t closest = 0;
+    float closest_t = t_max;
+    const bool hit = TraverseBVH(nodes.data(), r, t_min, t_max, [&](const BVHNode& node, float& closest_so_far)
+        {
+            bool hit_leaf = false;
+            const size_t end = 3 * (static_cast<size_t>(node.offset) + node.count);
+            for (size_t i = 3 * static_cast<size_t>(node.offset); i < end; i += 3)
+            {
+                float t;
+                if (ray.Intersect(vertices + 3 * static_cast<size_t>(indices[i]), vertices + 3 * static_cast<size_t>(indices[i + 1]),
+                    vertices + 3 * static_cast<size_t>(indices[i + 2]), t_min, closest_so_far, t))
+                {
+                    closest = i;
+                    closest_so_far = closest_t = t;
+                    hit_leaf = true;
+                }
+            }
+            RT_COUNT(Counters::Local().primitive_tests += node.count);
+            return hit_leaf;
+        });
+
+    if (!hit)
+    {
+        return false;
+    }
+
+    // The record is filled in once for the closest triangle, not for every leaf hit on the way
+    RT_COUNT(++Counters::Local().primitive_hits);
+    const Point3 a = GetVertex(indices[closest]);
+    const Point3 b = GetVertex(indices[closest + 1]);
+    const Point3 c = GetVertex(indices[closest + 2]);
+    rec.t = closest_t;
+    rec.p = r.GetCoordinateAt(closest_t);
+    rec.set_face_normal(r, Vector3::Cross(b - a, c - a).GetNormalized());
+    rec.mat_id = mat_id;
+
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "BVHNode.h"
+#include "Hittable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Indexed triangle mesh: shared vertex positions, a 32-bit index buffer and a
+// BVH over the triangles. Building the tree reorders the index buffer into leaf
+// order, so leaves are plain index ranges and no per-triangle objects or
+// permutation tables are kept.
+class TriangleMesh final : public Hittable
+{
+public:
+    static constexpr HittableType type = HittableType::TriangleMesh;
+
+    static constexpr int max_leaf_size = 8;
+
+    // positions holds x, y, z per vertex, indices three vertex indices per triangle
+    TriangleMesh(std::vector<float>&& _positions, std::vector<uint32_t>&& _indices, MaterialId _mat_id);
+
+    bool Hit(const Ray& r, float t_min, float t_max, HitRecord& rec) const override;
+
+    AABB GetBoundingBox() const override
+    {
+        return bounds;
+    }
+
+    HittableType GetType() const override
+    {
+        return type;
+    }
+
+    size_t GetVertexCount() const
+    {
+        return positions.size() / 3;
+    }
+
+    size_t GetTriangleCount() const
+    {
+        return indices.size() / 3;
+    }
+
+    // Bytes held by the vertex, index and node arrays
+    size_t GetMemoryUsage() const
+    {
+        return positions.capacity() * sizeof(float) + indices.capacity() * sizeof(uint32_t) + nodes.capacity() * sizeof(BVHNode);
+    }
+
+private:
+    Point3 GetVertex(uint32_t index) const
+    {
+        const float* p = &positions[3 * static_cast<size_t>(index)];
+        return Point3(p[0], p[1], p[2]);
+    }
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    std::vector<BVHNode> nodes;
+    AABB bounds;
+    MaterialId mat_id;
+};
@@ -0,0 +1,114 @@
+#include "ImageStream.h"
+
+#include <algorithm>
+#include <cassert>
+
+ImageStream::ImageStream(const ImageWriter& _writer, const FrameBuffer& _frame, int _band_height)
+    : writer(_writer), frame(_frame), band_height(_band_height)
+{
+    for (int first = 0; first < frame.height; first += band_height)
+    {
+        pixels_left.push_back(static_cast<size_t>(frame.width) * (std::min(first + band_height, frame.height) - first));
+    }
+}
+
+ImageStream::~ImageStream()
+{
+    if (thread.joinable())
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            abandoned = true;
+        }
+        band_done.notify_one();
+        thread.join();
+    }
+}
+
+bool ImageStream::Open(const char* path)
+{
+    file = std::fopen(path, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    const std::string header = writer.GetHeader(frame);
+    if (std::fwrite(header.data(), 1, header.size(), file) != header.size())
+    {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    thread = std::thread(&ImageStream::WriteBands, this);
+    return true;
+}
+
+std::vector<Tile> ImageStream::OrderTiles(std::vector<Tile> tiles) const
+{
+    const bool top_row_first = writer.IsTopRowFirst();
+    std::stable_sort(tiles.begin(), tiles.end(), [top_row_first](const Tile& a, const Tile& b)
+        {
+            return top_row_first ? a.y1 > b.y1 : a.y0 < b.y0;
+        });
+    return tiles;
+}
+
+void ImageStream::CommitTile(const Tile& tile)
+{
+    assert(frame.cleared && "streaming a frame that was never zeroed");
+
+    bool notify = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (int band = tile.y0 / band_height; band * band_height < tile.y1; ++band)
+        {
+            const int rows = std::min(tile.y1, (band + 1) * band_height) - std::max(tile.y0, band * band_height);
+            pixels_left[band] -= static_cast<size_t>(tile.x1 - tile.x0) * rows;
+            notify |= pixels_left[band] == 0;
+        }
+    }
+    if (notify)
+    {
+        band_done.notify_one();
+    }
+}
+
+bool ImageStream::Finish()
+{
+    thread.join();
+    return written;
+}
+
+void ImageStream::WriteBands()
+{
+    const bool top_row_first = writer.IsTopRowFirst();
+    const size_t row_size = writer.GetRowSize(frame);
+    const int band_count = static_cast<int>(pixels_left.size());
+    std::vector<uint8_t> data(row_size * band_height);
+
+    for (int k = 0; k < band_count && written; ++k)
+    {
+        const int band = top_row_first ? band_count - 1 - k : k;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            band_done.wait(lock, [this, band] { return pixels_left[band] == 0 || abandoned; });
+            if (pixels_left[band] != 0)
+            {
+                written = false;
+                break;
+            }
+        }
+
+        const int first = band * band_height;
+        const int end = std::min(first + band_height, frame.height);
+        for (int j = first; j < end; ++j)
+        {
+            const int position = top_row_first ? end - 1 - j : j - first;
+            writer.EncodeRow(frame, j, data.data() + position * row_size);
+        }
+        const size_t size = (end - first) * row_size;
+        written = std::fwrite(data.data(), 1, size, file) == size;
+    }
+
+    written = std::fclose(file) == 0 && written;
+}
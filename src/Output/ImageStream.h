@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ImageWriter.h"
+#include "../Render/FrameBuffer.h"
+#include "../Render/Tile.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Writes a frame to its file while it is being rendered, so encoding and disk
+// I/O are not left for after the last tile. Rows are grouped in bands; as
+// tiles are committed, a thread of its own encodes each band once all of its
+// pixels are in and appends it to the file, in file order. Bands finished
+// ahead of their turn simply wait in the frame, so no more than one band of
+// encoded bytes is held at a time. Rendering the tiles in the order
+// OrderTiles gives keeps the writer right behind the render.
+class ImageStream
+{
+public:
+    ImageStream(const ImageWriter& _writer, const FrameBuffer& _frame, int _band_height);
+    ~ImageStream();
+
+    // Creates the file, writes the header and starts the writer thread
+    bool Open(const char* path);
+
+    // The tiles, those the file needs first coming first
+    std::vector<Tile> OrderTiles(std::vector<Tile> tiles) const;
+
+    // Safe to call from the worker threads once the tile's pixels are final
+    void CommitTile(const Tile& tile);
+
+    // Waits for the last band to be written and closes the file. Every pixel
+    // must have been committed. Returns false if any write failed.
+    bool Finish();
+
+private:
+    void WriteBands();
+
+    const ImageWriter& writer;
+    const FrameBuffer& frame;
+    const int band_height;
+    std::vector<size_t> pixels_left;   // Per band, guarded by mutex
+    bool abandoned = false;            // Set when destroyed before Finish, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable band_done;
+    std::FILE* file = nullptr;
+    bool written = true;               // Owned by the writer thread until it is joined
+    std::thread thread;
+};
@@ -0,0 +1,35 @@
+#include "ImageWriter.h"
+#include "PfmWriter.h"
+#include "PpmWriter.h"
+
+#include <cassert>
+#include <vector>
+
+bool ImageWriter::Write(const FrameBuffer& frame, ThreadPool& threads, const char* path) const
+{
+    assert(frame.cleared && "writing a frame that was never zeroed");
+
+    const size_t row_size = GetRowSize(frame);
+    const bool top_row_first = IsTopRowFirst();
+
+    std::vector<uint8_t> data(row_size * frame.height);
+    ForEachRow(frame, threads, [&](int j)
+        {
+            const int position = top_row_first ? frame.height - 1 - j : j;
+            EncodeRow(frame, j, data.data() + position * row_size);
+        });
+
+    return WriteFile(path, GetHeader(frame), data.data(), data.size());
+}
+
+std::unique_ptr<ImageWriter> MakeImageWriter(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::PFM:
+        return std::make_unique<PfmWriter>();
+    case ImageFormat::PPM:
+    default:
+        return std::make_unique<PpmWriter>();
+    }
+}
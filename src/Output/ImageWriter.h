@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../Render/FrameBuffer.h"
+#include "../Render/RenderSettings.h"
+#include "../ThreadPool/ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Encodes a frame to a file. A format supplies its header and how one row is
+// encoded; Write converts a finished frame into one contiguous buffer on the
+// thread pool and hands it to the OS in a single write, and ImageStream writes
+// a frame band by band while it is still being rendered.
+class ImageWriter
+{
+public:
+    virtual ~ImageWriter() = default;
+
+    bool Write(const FrameBuffer& frame, ThreadPool& threads, const char* path) const;
+
+    virtual std::string GetHeader(const FrameBuffer& frame) const = 0;
+
+    // Bytes per encoded row
+    virtual size_t GetRowSize(const FrameBuffer& frame) const = 0;
+
+    // Whether the file starts with the top row; row 0 of the frame is the bottom
+    virtual bool IsTopRowFirst() const = 0;
+
+    virtual void EncodeRow(const FrameBuffer& frame, int j, uint8_t* out) const = 0;
+
+protected:
+    // Calls body(j) for every row of the frame, in bands spread over the pool,
+    // and returns once all rows are done
+    static void ForEachRow(const FrameBuffer& frame, ThreadPool& threads, const std::function<void(int)>& body)
+    {
+        constexpr int rows_per_job = 16;
+
+        const int job_count = (frame.height + rows_per_job - 1) / rows_per_job;
+        threads.QueueBatch(job_count, [&body, &frame](int band)
+            {
+                const int end = std::min((band + 1) * rows_per_job, frame.height);
+                for (int j = band * rows_per_job; j < end; ++j)
+                {
+                    body(j);
+                }
+            })->Wait();
+    }
+
+    static bool WriteFile(const char* path, const std::string& header, const void* data, size_t size)
+    {
+        std::FILE* file = std::fopen(path, "wb");
+        if (!file)
+        {
+            return false;
+        }
+        const bool written = std::fwrite(header.data(), 1, header.size(), file) == header.size()
+            && std::fwrite(data, 1, size, file) == size;
+        return std::fclose(file) == 0 && written;
+    }
+};
+
+std::unique_ptr<ImageWriter> MakeImageWriter(ImageFormat format);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ImageWriter.h"
+#include "ToneMap.h"
+
+#include <string>
+
+// Portable float map (PF): linear radiance per pixel as 32-bit floats, bottom
+// row first. Keeps the full HDR range for compositing or further accumulation.
+class PfmWriter final : public ImageWriter
+{
+public:
+    std::string GetHeader(const FrameBuffer& frame) const override
+    {
+        // A negative scale marks the data as little-endian, which every platform we build for is
+        return "PF\n" + std::to_string(frame.width) + ' ' + std::to_string(frame.height) + "\n-1.0\n";
+    }
+
+    size_t GetRowSize(const FrameBuffer& frame) const override
+    {
+        return static_cast<size_t>(frame.width) * 3 * sizeof(float);
+    }
+
+    bool IsTopRowFirst() const override
+    {
+        return false;
+    }
+
+    void EncodeRow(const FrameBuffer& frame, int j, uint8_t* out) const override
+    {
+        NormalizeRow(frame, j, reinterpret_cast<float*>(out));
+    }
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ImageWriter.h"
+#include "ToneMap.h"
+
+#include <string>
+
+// Binary 8-bit PPM (P6), gamma 2
+class PpmWriter final : public ImageWriter
+{
+public:
+    std::string GetHeader(const FrameBuffer& frame) const override
+    {
+        return "P6\n" + std::to_string(frame.width) + ' ' + std::to_string(frame.height) + "\n255\n";
+    }
+
+    size_t GetRowSize(const FrameBuffer& frame) const override
+    {
+        return static_cast<size_t>(frame.width) * 3;
+    }
+
+    bool IsTopRowFirst() const override
+    {
+        return true;
+    }
+
+    void EncodeRow(const FrameBuffer& frame, int j, uint8_t* out) const override
+    {
+        ToneMapRow(frame, j, out);
+    }
+};
@@ -0,0 +1,85 @@
+#include "ToneMap.h"
+#include "../CpuFeatures.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(RT_X86)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    inline uint8_t Quantize(float sum, float scale)
+    {
+        const float value = std::sqrt(sum * scale);
+        // NaN compares false, so it ends up as 0 like in the SSE path
+        return static_cast<uint8_t>(256.0f * (value > 0.0f ? std::min(value, 0.999f) : 0.0f));
+    }
+}
+
+void ToneMapRow(const FrameBuffer& frame, int j, uint8_t* out)
+{
+    const size_t row = static_cast<size_t>(j) * frame.width;
+    const float* color = frame.color.data() + row * 3;
+    const uint32_t* counts = frame.sample_counts.data() + row;
+
+    int i = 0;
+#if defined(RT_X86)
+    // SSE2 is part of x86-64, so this needs no dispatch. Four pixels are twelve
+    // floats; the per-pixel scales are shuffled to line up with r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3.
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_value = _mm_set1_ps(0.999f);
+    const __m128 full_scale = _mm_set1_ps(256.0f);
+    for (; i + 4 <= frame.width; i += 4)
+    {
+        const __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + i));
+        const __m128 scale = _mm_div_ps(one, _mm_cvtepi32_ps(n));
+        const __m128 scales[3] = {
+            _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(1, 0, 0, 0)),
+            _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(2, 2, 1, 1)),
+            _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(3, 3, 3, 2)),
+        };
+
+        __m128i quantized[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            __m128 v = _mm_sqrt_ps(_mm_mul_ps(_mm_loadu_ps(color + i * 3 + k * 4), scales[k]));
+            // maxps returns the second operand for NaN, which maps NaN to 0
+            v = _mm_min_ps(_mm_max_ps(v, zero), max_value);
+            quantized[k] = _mm_cvttps_epi32(_mm_mul_ps(v, full_scale));
+        }
+
+        const __m128i words0 = _mm_packs_epi32(quantized[0], quantized[1]);
+        const __m128i words1 = _mm_packs_epi32(quantized[2], quantized[2]);
+        alignas(16) uint8_t bytes[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(bytes), _mm_packus_epi16(words0, words1));
+        std::memcpy(out + i * 3, bytes, 12);
+    }
+#endif
+
+    for (; i < frame.width; ++i)
+    {
+        const float scale = 1.0f / counts[i];
+        out[i * 3] = Quantize(color[i * 3], scale);
+        out[i * 3 + 1] = Quantize(color[i * 3 + 1], scale);
+        out[i * 3 + 2] = Quantize(color[i * 3 + 2], scale);
+    }
+}
+
+void NormalizeRow(const FrameBuffer& frame, int j, float* out)
+{
+    const size_t row = static_cast<size_t>(j) * frame.width;
+    const float* color = frame.color.data() + row * 3;
+    const uint32_t* counts = frame.sample_counts.data() + row;
+
+    for (int i = 0; i < frame.width; ++i)
+    {
+        const float scale = 1.0f / counts[i];
+        out[i * 3] = color[i * 3] * scale;
+        out[i * 3 + 1] = color[i * 3 + 1] * scale;
+        out[i * 3 + 2] = color[i * 3 + 2] * scale;
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "../Render/FrameBuffer.h"
+
+#include <cstdint>
+
+// Converts row j of the frame to 8-bit sRGB-ish triples: divide by the pixel's
+// sample count, gamma 2, clamp to [0, 0.999] and scale by 256. Writes
+// 3 * frame.width bytes to out.
+void ToneMapRow(const FrameBuffer& frame, int j, uint8_t* out);
+
+// Writes row j of the frame as linear radiance, 3 floats per pixel
+void NormalizeRow(const FrameBuffer& frame, int j, float* out);
@@ -0,0 +1,44 @@
+#pragma once
+#include "Ray.h"
+
+#include <cstdint>
+
+// A bundle of coherent rays in structure-of-arrays form. Lanes are processed
+// together so per-node work in the BVH is shared by the whole packet.
+struct RayPacket
+{
+    static constexpr int size = 8;
+    static constexpr uint32_t all_lanes = (1u << size) - 1;
+
+    alignas(32) float origin_x[size];
+    alignas(32) float origin_y[size];
+    alignas(32) float origin_z[size];
+    alignas(32) float direction_x[size];
+    alignas(32) float direction_y[size];
+    alignas(32) float direction_z[size];
+    alignas(32) float inv_direction_x[size];
+    alignas(32) float inv_direction_y[size];
+    alignas(32) float inv_direction_z[size];
+
+    void SetRay(int lane, const Ray& r)
+    {
+        const Vector3 origin = r.GetOrigin();
+        const Vector3 direction = r.GetDirection();
+
+        origin_x[lane] = origin.x;
+        origin_y[lane] = origin.y;
+        origin_z[lane] = origin.z;
+        direction_x[lane] = direction.x;
+        direction_y[lane] = direction.y;
+        direction_z[lane] = direction.z;
+        inv_direction_x[lane] = 1.0f / direction.x;
+        inv_direction_y[lane] = 1.0f / direction.y;
+        inv_direction_z[lane] = 1.0f / direction.z;
+    }
+
+    Ray GetRay(int lane) const
+    {
+        return Ray(Vector3(origin_x[lane], origin_y[lane], origin_z[lane]),
+            Vector3(direction_x[lane], direction_y[lane], direction_z[lane]));
+    }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "RenderSettings.h"
+#include "../Vector3Float.h"
+
+#include <cmath>
+
+inline float Luminance(const Vector3& c)
+{
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+// Running mean and variance of a pixel's sample luminance (Welford's method)
+struct PixelStats
+{
+    int count = 0;
+    float mean = 0.0f;
+    float m2 = 0.0f;
+
+    void Add(const Vector3& sample)
+    {
+        const float x = Luminance(sample);
+        ++count;
+        const float delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
+    }
+
+    // Standard error of the mean scaled by 1/sqrt(mean), which approximates the
+    // error after the gamma-2 output transform. The offset keeps near-black
+    // pixels from demanding an absolute error of zero.
+    float GetRelativeError() const
+    {
+        if (count < 2)
+        {
+            return infinity;
+        }
+        const float variance = m2 / (count - 1);
+        return std::sqrt(variance / count) / std::sqrt(mean + 1e-3f);
+    }
+};
+
+// Whether a pixel that has taken `taken` samples should stop. Without adaptive
+// sampling every pixel takes exactly samples_per_pixel.
+inline bool Is_pixel_done(const PixelStats& stats, int taken, const RenderSettings& settings)
+{
+    if (taken >= settings.samples_per_pixel)
+    {
+        return true;
+    }
+    if (!settings.adaptive_sampling || taken < settings.min_samples_per_pixel)
+    {
+        return false;
+    }
+    // Only test at batch boundaries so a lucky streak of similar samples cannot stop a pixel early
+    if ((taken - settings.min_samples_per_pixel) % settings.adaptive_batch != 0)
+    {
+        return false;
+    }
+    return stats.GetRelativeError() <= settings.adaptive_threshold;
+}
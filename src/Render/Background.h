@@ -0,0 +1,11 @@
+#pragma once
+
+#include "../Ray.h"
+
+// Radiance for rays that leave the scene: a vertical white-to-blue gradient
+inline Vector3 Sky_color(const Ray& r)
+{
+    const Vector3 unit_direction = r.GetDirection().GetNormalized();
+    const auto t = kernel_real(0.5) * (unit_direction.y + kernel_real(1));
+    return (kernel_real(1) - t) * Vector3(1.0f, 1.0f, 1.0f) + t * Vector3(0.5f, 0.7f, 1.0f);
+}
@@ -0,0 +1,223 @@
+#include "Checkpoint.h"
+#include "../CpuFeatures.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#endif
+
+static_assert(sizeof(CheckpointHeader) == 80, "CheckpointHeader layout is part of the file format");
+static_assert(sizeof(PixelStats) == 12, "PixelStats layout is part of the file format");
+
+namespace
+{
+    constexpr uint32_t max_scene_name_length = 4096;
+
+    CheckpointHeader MakeHeader(const FrameBuffer& frame, const RenderSettings& settings, uint64_t scene_seed)
+    {
+        CheckpointHeader header = {};
+        std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+        header.version = checkpoint_version;
+        header.header_size = sizeof(CheckpointHeader);
+        header.scene_seed = scene_seed;
+        header.image_width = frame.width;
+        header.image_height = frame.height;
+        header.max_depth = settings.max_depth;
+        header.russian_roulette = settings.russian_roulette;
+        header.roulette_min_depth = settings.roulette_min_depth;
+        header.adaptive_sampling = settings.adaptive_sampling;
+        header.min_samples_per_pixel = settings.min_samples_per_pixel;
+        header.adaptive_batch = settings.adaptive_batch;
+        header.integrator = static_cast<uint32_t>(settings.integrator);
+        header.packet_tracing = settings.packet_tracing;
+        header.scene_source = static_cast<uint32_t>(settings.GetSceneSource());
+        header.scene_name_length = static_cast<uint32_t>(std::strlen(settings.GetSceneName()));
+        header.has_stats = !frame.stats.empty();
+        header.simd_level = static_cast<uint32_t>(ActiveSimdLevel());
+        return header;
+    }
+
+    // Names the first setting the checkpoint was rendered with differently
+    bool MatchSettings(const CheckpointHeader& saved, const std::string& saved_scene, const CheckpointHeader& current, const std::string& current_scene, std::string& error)
+    {
+        if (saved.image_width != current.image_width || saved.image_height != current.image_height)
+        {
+            error = "checkpoint is " + std::to_string(saved.image_width) + "x" + std::to_string(saved.image_height);
+            return false;
+        }
+        if (saved.scene_source != current.scene_source || saved_scene != current_scene || saved.scene_seed != current.scene_seed)
+        {
+            error = "checkpoint is of scene " + saved_scene;
+            return false;
+        }
+
+        const struct
+        {
+            const char* name;
+            int64_t saved;
+            int64_t current;
+        } fields[] =
+        {
+            { "depth", saved.max_depth, current.max_depth },
+            { "Russian roulette setting", saved.russian_roulette ? saved.roulette_min_depth : -1, current.russian_roulette ? current.roulette_min_depth : -1 },
+            { "adaptive sampling setting", saved.adaptive_sampling, current.adaptive_sampling },
+            { "minimum sample count", saved.min_samples_per_pixel, current.min_samples_per_pixel },
+            { "adaptive batch size", saved.adaptive_batch, current.adaptive_batch },
+            { "integrator", saved.integrator, current.integrator },
+            { "packet setting", saved.packet_tracing, current.packet_tracing },
+            { "SIMD level", saved.simd_level, current.simd_level },
+        };
+        for (const auto& field : fields)
+        {
+            if (field.saved != field.current)
+            {
+                error = std::string("checkpoint was rendered with a different ") + field.name;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ReadExactly(std::FILE* file, void* data, size_t size)
+    {
+        return std::fread(data, 1, size, file) == size;
+    }
+
+    bool WriteExactly(std::FILE* file, const void* data, size_t size)
+    {
+        return std::fwrite(data, 1, size, file) == size;
+    }
+
+    // Replaces to with from in one step, so there is never a moment without either
+    bool MoveOverFile(const char* from, const char* to)
+    {
+#if defined(_WIN32)
+        // rename refuses to replace an existing file on Windows
+        return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return std::rename(from, to) == 0;
+#endif
+    }
+}
+
+bool SaveCheckpoint(const FrameBuffer& frame, const RenderSettings& settings, uint64_t scene_seed, const char* path, std::string& error)
+{
+    const CheckpointHeader header = MakeHeader(frame, settings, scene_seed);
+    const std::string temporary_path = std::string(path) + ".part";
+
+    std::FILE* file = std::fopen(temporary_path.c_str(), "wb");
+    if (!file)
+    {
+        error = "cannot create " + temporary_path;
+        return false;
+    }
+    bool written = WriteExactly(file, &header, sizeof(header))
+        && WriteExactly(file, settings.GetSceneName(), header.scene_name_length)
+        && WriteExactly(file, frame.color.data(), frame.color.size() * sizeof(float))
+        && WriteExactly(file, frame.sample_counts.data(), frame.sample_counts.size() * sizeof(uint32_t))
+        && WriteExactly(file, frame.stats.data(), frame.stats.size() * sizeof(PixelStats));
+    written = std::fclose(file) == 0 && written;
+    if (!written)
+    {
+        std::remove(temporary_path.c_str());
+        error = "cannot write " + temporary_path;
+        return false;
+    }
+
+    if (!MoveOverFile(temporary_path.c_str(), path))
+    {
+        error = "cannot rename " + temporary_path + " to " + path;
+        return false;
+    }
+    return true;
+}
+
+bool LoadCheckpoint(const char* path, const RenderSettings& settings, uint64_t scene_seed, FrameBuffer& frame, std::string& error)
+{
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file)
+    {
+        error = "cannot open file";
+        return false;
+    }
+
+    CheckpointHeader header;
+    std::string scene_name;
+    bool valid = ReadExactly(file, &header, sizeof(header))
+        && std::memcmp(header.magic, checkpoint_magic, sizeof(header.magic)) == 0
+        && header.version == checkpoint_version
+        && header.header_size == sizeof(CheckpointHeader)
+        && header.scene_name_length <= max_scene_name_length;
+    if (valid)
+    {
+        scene_name.resize(header.scene_name_length);
+        valid = ReadExactly(file, scene_name.data(), scene_name.size());
+    }
+    if (!valid)
+    {
+        std::fclose(file);
+        error = "not a checkpoint file";
+        return false;
+    }
+
+    if (!MatchSettings(header, scene_name, MakeHeader(frame, settings, scene_seed), settings.GetSceneName(), error))
+    {
+        std::fclose(file);
+        return false;
+    }
+    if (settings.adaptive_sampling && !header.has_stats)
+    {
+        std::fclose(file);
+        error = "checkpoint has no adaptive sampling statistics";
+        return false;
+    }
+
+    const size_t pixels = static_cast<size_t>(frame.width) * frame.height;
+    valid = ReadExactly(file, frame.color.data(), pixels * 3 * sizeof(float))
+        && ReadExactly(file, frame.sample_counts.data(), pixels * sizeof(uint32_t))
+        && (!header.has_stats || ReadExactly(file, frame.stats.data(), frame.stats.size() * sizeof(PixelStats)));
+    std::fclose(file);
+    if (!valid)
+    {
+        error = "file is truncated";
+        return false;
+    }
+    return true;
+}
+
+void TileCheckpointer::CommitTile(const Tile& tile)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (int j = tile.y0; j < tile.y1; ++j)
+    {
+        const size_t first = static_cast<size_t>(j) * live.width + tile.x0;
+        const size_t count = static_cast<size_t>(tile.x1 - tile.x0);
+        std::memcpy(&snapshot.color[first * 3], &live.color[first * 3], count * 3 * sizeof(float));
+        std::memcpy(&snapshot.sample_counts[first], &live.sample_counts[first], count * sizeof(uint32_t));
+        if (!live.stats.empty())
+        {
+            std::memcpy(&snapshot.stats[first], &live.stats[first], count * sizeof(PixelStats));
+        }
+    }
+}
+
+bool TileCheckpointer::Save(const RenderSettings& settings, uint64_t scene_seed, const char* path, std::string& error)
+{
+    std::unique_lock<std::mutex> save_lock(save_mutex);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        saving.color = snapshot.color;
+        saving.sample_counts = snapshot.sample_counts;
+        saving.stats = snapshot.stats;
+    }
+    return SaveCheckpoint(saving, settings, scene_seed, path, error);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "AdaptiveSampling.h"
+#include "FrameBuffer.h"
+#include "RenderSettings.h"
+#include "Tile.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Checkpoint files: the raw accumulation state of a frame, which a later run
+// continues from. Samples are seeded by pixel and sample index, so there is
+// no random number state to save, and continuing a frame to N samples per
+// pixel gives bit for bit the frame one N-sample render would.
+//
+//   CheckpointHeader
+//   char scene_name[scene_name_length]
+//   float color[width * height * 3]     per-pixel radiance sums
+//   uint32_t samples[width * height]
+//   PixelStats stats[width * height]    only if has_stats
+//
+// Everything is little-endian. The header records each setting that changes
+// sample values, including the SIMD level the kernels ran at, and resuming
+// with a different one is refused. The sample count may change, which is how
+// a render is extended; so may the adaptive threshold, which stays exact when
+// it is lowered.
+
+constexpr char checkpoint_magic[8] = { 'R', 'T', 'A', 'C', 'C', 'U', 'M', '\0' };
+constexpr uint32_t checkpoint_version = 2;
+
+struct CheckpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;        // sizeof(CheckpointHeader) of the writer
+    uint64_t scene_seed;
+    int32_t image_width;
+    int32_t image_height;
+    int32_t max_depth;
+    uint32_t russian_roulette;
+    int32_t roulette_min_depth;
+    uint32_t adaptive_sampling;
+    int32_t min_samples_per_pixel;
+    int32_t adaptive_batch;
+    uint32_t integrator;         // IntegratorType
+    uint32_t packet_tracing;
+    uint32_t scene_source;       // SceneSource
+    uint32_t scene_name_length;
+    uint32_t has_stats;
+    uint32_t simd_level;         // SimdLevel the kernels ran at, after capping to the CPU
+};
+
+// Writes to a temporary file first, so an interrupted save leaves the previous checkpoint intact
+bool SaveCheckpoint(const FrameBuffer& frame, const RenderSettings& settings, uint64_t scene_seed, const char* path, std::string& error);
+
+// Fills a frame of the checkpoint's size. Statistics are loaded if both the
+// checkpoint and the frame have them; an adaptive render needs them.
+bool LoadCheckpoint(const char* path, const RenderSettings& settings, uint64_t scene_seed, FrameBuffer& frame, std::string& error);
+
+// Saves checkpoints while a frame is being rendered. Only finished tiles are
+// copied in, so a save never catches a pixel halfway through an update, and
+// every other pixel keeps the state the render started from.
+class TileCheckpointer
+{
+public:
+    explicit TileCheckpointer(const FrameBuffer& _live)
+        : live(_live), snapshot(_live), saving(_live.width, _live.height, !_live.stats.empty())
+    {
+    }
+
+    // Safe to call from the worker threads
+    void CommitTile(const Tile& tile);
+
+    // Copies the committed tiles and writes them with the lock released, so
+    // workers committing tiles never wait on the disk
+    bool Save(const RenderSettings& settings, uint64_t scene_seed, const char* path, std::string& error);
+
+private:
+    const FrameBuffer& live;
+    FrameBuffer snapshot;
+    FrameBuffer saving;       // The copy being written, guarded by save_mutex
+    std::mutex mutex;         // Guards snapshot
+    std::mutex save_mutex;
+};
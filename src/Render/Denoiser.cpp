@@ -0,0 +1,478 @@
+#include "Denoiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(RT_X86)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr int pass_count = 5;
+    constexpr float sigma_luminance = 4.0f;    // In standard deviations of the center's noise
+    constexpr float sigma_normal = 1.0f;
+    constexpr float sigma_depth = 0.05f;       // Relative depth change per pixel
+    constexpr float sigma_albedo = 0.5f;
+    constexpr float albedo_offset = 0.01f;     // Keeps demodulation finite where the albedo is black
+    constexpr int min_variance_samples = 2;    // Pixels with fewer have their noise estimated from the neighbours
+    constexpr int spatial_variance_radius = 1;
+
+    // B3 spline, the a-trous kernel
+    constexpr float kernel_weights[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+    // The first-hit features are fixed; color and variance ping-pong between the two sets
+    struct DenoiseImage
+    {
+        int width;
+        int height;
+        std::vector<float> normal_x, normal_y, normal_z, depth;
+        std::vector<float> albedo_r, albedo_g, albedo_b;
+        std::vector<float> weight;        // 1, or 0 for a pixel whose sums are not finite
+        std::vector<float> color_r[2], color_g[2], color_b[2];
+        std::vector<float> variance[2];   // Of the luminance of each pixel's mean
+    };
+
+    struct DenoisePass
+    {
+        int width;
+        int height;
+        int step;
+        const float* normal_x;
+        const float* normal_y;
+        const float* normal_z;
+        const float* depth;
+        const float* albedo_r;
+        const float* albedo_g;
+        const float* albedo_b;
+        const float* weight;
+        const float* in_r;
+        const float* in_g;
+        const float* in_b;
+        const float* in_variance;
+        float* out_r;
+        float* out_g;
+        float* out_b;
+        float* out_variance;
+    };
+
+    using DenoiseRowKernel = void (*)(const DenoisePass& pass, int j);
+
+    inline float PlaneLuminance(float r, float g, float b)
+    {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+    // exp(x) for x <= 0 to about 1e-7 relative, the same polynomial as the AVX2
+    // kernel. The argument is clamped to [-80, 0] so the exponent bits cannot
+    // overflow; NaN fails the comparison and comes out as exp(-80).
+    inline float FastExp(float x)
+    {
+        const float t = (x > -80.0f ? std::min(x, 0.0f) : -80.0f) * 1.44269504f;
+        const float whole = std::floor(t);
+        const float f = t - whole;
+        const float p = 1.0f + f * (0.693147182f + f * (0.240226507f + f * (0.0555041086f + f * (0.00961812911f + f * 0.00133335581f))));
+        const int32_t bits = (static_cast<int32_t>(whole) + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+        return p * scale;
+    }
+
+    // 3x3 Gaussian of the variance, which steadies the few-sample estimates
+    inline float BlurredVariance(const DenoisePass& pass, int i, int j)
+    {
+        constexpr float weights[3] = { 0.25f, 0.5f, 0.25f };
+        float sum = 0.0f;
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            const int y = std::clamp(j + dy, 0, pass.height - 1);
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int x = std::clamp(i + dx, 0, pass.width - 1);
+                sum += weights[dx + 1] * weights[dy + 1] * pass.in_variance[static_cast<size_t>(y) * pass.width + x];
+            }
+        }
+        return sum;
+    }
+
+    void FilterPixel(const DenoisePass& pass, int i, int j)
+    {
+        const size_t p = static_cast<size_t>(j) * pass.width + i;
+        const float luminance = PlaneLuminance(pass.in_r[p], pass.in_g[p], pass.in_b[p]);
+        const float luminance_scale = 1.0f / (sigma_luminance * std::sqrt(std::max(BlurredVariance(pass, i, j), 0.0f)) + 1e-3f);
+        const float depth_scale = 1.0f / (sigma_depth * pass.step * pass.depth[p] + 1e-3f);
+        const float normal_scale = 1.0f / (sigma_normal * sigma_normal);
+        const float albedo_scale = 1.0f / (sigma_albedo * sigma_albedo);
+
+        float weight_sum = 0.0f;
+        float sum_r = 0.0f;
+        float sum_g = 0.0f;
+        float sum_b = 0.0f;
+        float variance_sum = 0.0f;
+        for (int ty = 0; ty < 5; ++ty)
+        {
+            const int y = j + (ty - 2) * pass.step;
+            if (y < 0 || y >= pass.height)
+            {
+                continue;
+            }
+            for (int tx = 0; tx < 5; ++tx)
+            {
+                const int x = i + (tx - 2) * pass.step;
+                if (x < 0 || x >= pass.width)
+                {
+                    continue;
+                }
+                const size_t q = static_cast<size_t>(y) * pass.width + x;
+                const float tap_distance = static_cast<float>(std::max(std::abs(tx - 2), std::abs(ty - 2)));
+
+                const float dn_x = pass.normal_x[q] - pass.normal_x[p];
+                const float dn_y = pass.normal_y[q] - pass.normal_y[p];
+                const float dn_z = pass.normal_z[q] - pass.normal_z[p];
+                const float da_r = pass.albedo_r[q] - pass.albedo_r[p];
+                const float da_g = pass.albedo_g[q] - pass.albedo_g[p];
+                const float da_b = pass.albedo_b[q] - pass.albedo_b[p];
+                const float exponent = std::abs(PlaneLuminance(pass.in_r[q], pass.in_g[q], pass.in_b[q]) - luminance) * luminance_scale
+                    + (dn_x * dn_x + dn_y * dn_y + dn_z * dn_z) * normal_scale
+                    + std::abs(pass.depth[q] - pass.depth[p]) * depth_scale / std::max(tap_distance, 1.0f)
+                    + (da_r * da_r + da_g * da_g + da_b * da_b) * albedo_scale;
+                const float w = kernel_weights[tx] * kernel_weights[ty] * pass.weight[q] * FastExp(-exponent);
+
+                weight_sum += w;
+                sum_r += w * pass.in_r[q];
+                sum_g += w * pass.in_g[q];
+                sum_b += w * pass.in_b[q];
+                variance_sum += w * w * pass.in_variance[q];
+            }
+        }
+
+        // weight_sum vanishes only where every tap is a non-finite pixel, which then stays black
+        const float inverse = weight_sum > 0.0f ? 1.0f / weight_sum : 0.0f;
+        pass.out_r[p] = sum_r * inverse;
+        pass.out_g[p] = sum_g * inverse;
+        pass.out_b[p] = sum_b * inverse;
+        pass.out_variance[p] = variance_sum * inverse * inverse;
+    }
+
+    struct DenoiserKernels
+    {
+        static void FilterRowScalar(const DenoisePass& pass, int j)
+        {
+            for (int i = 0; i < pass.width; ++i)
+            {
+                FilterPixel(pass, i, j);
+            }
+        }
+
+#if defined(RT_X86)
+        RT_TARGET("avx2,fma")
+        static __m256 FastExpAvx2(__m256 x)
+        {
+            // max_ps returns its second operand for NaN
+            const __m256 clamped = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-80.0f)), _mm256_setzero_ps());
+            const __m256 t = _mm256_mul_ps(clamped, _mm256_set1_ps(1.44269504f));
+            const __m256 whole = _mm256_floor_ps(t);
+            const __m256 f = _mm256_sub_ps(t, whole);
+            __m256 p = _mm256_set1_ps(0.00133335581f);
+            p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(0.00961812911f));
+            p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(0.0555041086f));
+            p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(0.240226507f));
+            p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(0.693147182f));
+            p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+            const __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127)), 23);
+            return _mm256_mul_ps(p, _mm256_castsi256_ps(bits));
+        }
+
+        RT_TARGET("avx2,fma")
+        static __m256 LuminanceAvx2(__m256 r, __m256 g, __m256 b)
+        {
+            return _mm256_fmadd_ps(_mm256_set1_ps(0.2126f), r, _mm256_fmadd_ps(_mm256_set1_ps(0.7152f), g, _mm256_mul_ps(_mm256_set1_ps(0.0722f), b)));
+        }
+
+        // Eight pixels at a time where all taps of the row fall inside the
+        // image horizontally; FilterPixel handles the borders
+        RT_TARGET("avx2,fma")
+        static void FilterRowAvx2(const DenoisePass& pass, int j)
+        {
+            const int reach = 2 * pass.step;
+            int i = 0;
+            for (; i < std::min(reach, pass.width); ++i)
+            {
+                FilterPixel(pass, i, j);
+            }
+
+            const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+            const __m256 normal_scale = _mm256_set1_ps(1.0f / (sigma_normal * sigma_normal));
+            const __m256 albedo_scale = _mm256_set1_ps(1.0f / (sigma_albedo * sigma_albedo));
+            const __m256 depth_factor = _mm256_set1_ps(sigma_depth * pass.step);
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256 epsilon = _mm256_set1_ps(1e-3f);
+            const float blur_weights[3] = { 0.25f, 0.5f, 0.25f };
+            const size_t row = static_cast<size_t>(j) * pass.width;
+
+            for (; i + 8 + reach <= pass.width; i += 8)
+            {
+                const size_t p = row + i;
+                const __m256 p_r = _mm256_loadu_ps(pass.in_r + p);
+                const __m256 p_g = _mm256_loadu_ps(pass.in_g + p);
+                const __m256 p_b = _mm256_loadu_ps(pass.in_b + p);
+                const __m256 p_nx = _mm256_loadu_ps(pass.normal_x + p);
+                const __m256 p_ny = _mm256_loadu_ps(pass.normal_y + p);
+                const __m256 p_nz = _mm256_loadu_ps(pass.normal_z + p);
+                const __m256 p_depth = _mm256_loadu_ps(pass.depth + p);
+                const __m256 p_ar = _mm256_loadu_ps(pass.albedo_r + p);
+                const __m256 p_ag = _mm256_loadu_ps(pass.albedo_g + p);
+                const __m256 p_ab = _mm256_loadu_ps(pass.albedo_b + p);
+                const __m256 luminance = LuminanceAvx2(p_r, p_g, p_b);
+
+                // reach >= 2, so the 3x3 blur needs no horizontal clamp here
+                __m256 blurred = _mm256_setzero_ps();
+                for (int dy = -1; dy <= 1; ++dy)
+                {
+                    const int y = std::clamp(j + dy, 0, pass.height - 1);
+                    const float* v = pass.in_variance + static_cast<size_t>(y) * pass.width + i;
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        blurred = _mm256_fmadd_ps(_mm256_set1_ps(blur_weights[dx + 1] * blur_weights[dy + 1]), _mm256_loadu_ps(v + dx), blurred);
+                    }
+                }
+                const __m256 sigma = _mm256_mul_ps(_mm256_set1_ps(sigma_luminance), _mm256_sqrt_ps(_mm256_max_ps(blurred, _mm256_setzero_ps())));
+                const __m256 luminance_scale = _mm256_div_ps(one, _mm256_add_ps(sigma, epsilon));
+                const __m256 depth_scale = _mm256_div_ps(one, _mm256_fmadd_ps(depth_factor, p_depth, epsilon));
+
+                __m256 weight_sum = _mm256_setzero_ps();
+                __m256 sum_r = _mm256_setzero_ps();
+                __m256 sum_g = _mm256_setzero_ps();
+                __m256 sum_b = _mm256_setzero_ps();
+                __m256 variance_sum = _mm256_setzero_ps();
+                for (int ty = 0; ty < 5; ++ty)
+                {
+                    const int y = j + (ty - 2) * pass.step;
+                    if (y < 0 || y >= pass.height)
+                    {
+                        continue;
+                    }
+                    for (int tx = 0; tx < 5; ++tx)
+                    {
+                        const size_t q = static_cast<size_t>(y) * pass.width + i + (tx - 2) * pass.step;
+                        const float tap_distance = static_cast<float>(std::max(std::abs(tx - 2), std::abs(ty - 2)));
+
+                        const __m256 q_r = _mm256_loadu_ps(pass.in_r + q);
+                        const __m256 q_g = _mm256_loadu_ps(pass.in_g + q);
+                        const __m256 q_b = _mm256_loadu_ps(pass.in_b + q);
+                        const __m256 dn_x = _mm256_sub_ps(_mm256_loadu_ps(pass.normal_x + q), p_nx);
+                        const __m256 dn_y = _mm256_sub_ps(_mm256_loadu_ps(pass.normal_y + q), p_ny);
+                        const __m256 dn_z = _mm256_sub_ps(_mm256_loadu_ps(pass.normal_z + q), p_nz);
+                        const __m256 da_r = _mm256_sub_ps(_mm256_loadu_ps(pass.albedo_r + q), p_ar);
+                        const __m256 da_g = _mm256_sub_ps(_mm256_loadu_ps(pass.albedo_g + q), p_ag);
+                        const __m256 da_b = _mm256_sub_ps(_mm256_loadu_ps(pass.albedo_b + q), p_ab);
+                        const __m256 d_luminance = _mm256_andnot_ps(sign_mask, _mm256_sub_ps(LuminanceAvx2(q_r, q_g, q_b), luminance));
+                        const __m256 d_depth = _mm256_andnot_ps(sign_mask, _mm256_sub_ps(_mm256_loadu_ps(pass.depth + q), p_depth));
+                        const __m256 normal_distance = _mm256_fmadd_ps(dn_x, dn_x, _mm256_fmadd_ps(dn_y, dn_y, _mm256_mul_ps(dn_z, dn_z)));
+                        const __m256 albedo_distance = _mm256_fmadd_ps(da_r, da_r, _mm256_fmadd_ps(da_g, da_g, _mm256_mul_ps(da_b, da_b)));
+
+                        __m256 exponent = _mm256_mul_ps(d_luminance, luminance_scale);
+                        exponent = _mm256_fmadd_ps(normal_distance, normal_scale, exponent);
+                        exponent = _mm256_fmadd_ps(_mm256_mul_ps(d_depth, depth_scale), _mm256_set1_ps(1.0f / std::max(tap_distance, 1.0f)), exponent);
+                        exponent = _mm256_fmadd_ps(albedo_distance, albedo_scale, exponent);
+                        const __m256 tap_weight = _mm256_mul_ps(_mm256_set1_ps(kernel_weights[tx] * kernel_weights[ty]), _mm256_loadu_ps(pass.weight + q));
+                        const __m256 w = _mm256_mul_ps(tap_weight, FastExpAvx2(_mm256_xor_ps(exponent, sign_mask)));
+
+                        weight_sum = _mm256_add_ps(weight_sum, w);
+                        sum_r = _mm256_fmadd_ps(w, q_r, sum_r);
+                        sum_g = _mm256_fmadd_ps(w, q_g, sum_g);
+                        sum_b = _mm256_fmadd_ps(w, q_b, sum_b);
+                        variance_sum = _mm256_fmadd_ps(_mm256_mul_ps(w, w), _mm256_loadu_ps(pass.in_variance + q), variance_sum);
+                    }
+                }
+
+                const __m256 covered = _mm256_cmp_ps(weight_sum, _mm256_setzero_ps(), _CMP_GT_OQ);
+                const __m256 inverse = _mm256_and_ps(covered, _mm256_div_ps(one, weight_sum));
+                _mm256_storeu_ps(pass.out_r + p, _mm256_mul_ps(sum_r, inverse));
+                _mm256_storeu_ps(pass.out_g + p, _mm256_mul_ps(sum_g, inverse));
+                _mm256_storeu_ps(pass.out_b + p, _mm256_mul_ps(sum_b, inverse));
+                _mm256_storeu_ps(pass.out_variance + p, _mm256_mul_ps(variance_sum, _mm256_mul_ps(inverse, inverse)));
+            }
+
+            for (; i < pass.width; ++i)
+            {
+                FilterPixel(pass, i, j);
+            }
+        }
+#endif
+
+        static DenoiseRowKernel Select(SimdLevel level)
+        {
+#if defined(RT_X86)
+            if (level >= SimdLevel::AVX2)
+            {
+                return &FilterRowAvx2;
+            }
+#endif
+            return &FilterRowScalar;
+        }
+    };
+
+    // Calls body(j) for every row, in bands spread over the pool, and returns once all rows are done
+    void ForEachRow(int height, ThreadPool& threads, const std::function<void(int)>& body)
+    {
+        constexpr int rows_per_job = 8;
+
+        const int job_count = (height + rows_per_job - 1) / rows_per_job;
+        threads.QueueBatch(job_count, [&body, height](int band)
+            {
+                const int end = std::min((band + 1) * rows_per_job, height);
+                for (int j = band * rows_per_job; j < end; ++j)
+                {
+                    body(j);
+                }
+            })->Wait();
+    }
+
+    // Demodulated mean color, features and noise estimate of row j
+    void LoadRow(const FrameBuffer& frame, DenoiseImage& image, int j)
+    {
+        for (int i = 0; i < frame.width; ++i)
+        {
+            const size_t p = static_cast<size_t>(j) * frame.width + i;
+            const PixelFeatures& feature = frame.features[p];
+            float albedo[3] = { 1.0f, 1.0f, 1.0f };
+            if (feature.count > 0.0f)
+            {
+                const float inverse = 1.0f / feature.count;
+                for (int c = 0; c < 3; ++c)
+                {
+                    albedo[c] = feature.albedo[c] * inverse;
+                }
+                image.normal_x[p] = feature.normal[0] * inverse;
+                image.normal_y[p] = feature.normal[1] * inverse;
+                image.normal_z[p] = feature.normal[2] * inverse;
+                image.depth[p] = feature.depth * inverse;
+            }
+            image.albedo_r[p] = albedo[0];
+            image.albedo_g[p] = albedo[1];
+            image.albedo_b[p] = albedo[2];
+
+            // A NaN or infinite sum would spread over the whole filter footprint,
+            // so the pixel is blacked out and left for its neighbours to fill
+            const float* sum = &frame.color[p * 3];
+            if (!std::isfinite(sum[0]) || !std::isfinite(sum[1]) || !std::isfinite(sum[2]))
+            {
+                image.color_r[0][p] = 0.0f;
+                image.color_g[0][p] = 0.0f;
+                image.color_b[0][p] = 0.0f;
+                image.variance[0][p] = 0.0f;
+                image.weight[p] = 0.0f;
+                continue;
+            }
+            image.weight[p] = 1.0f;
+
+            const uint32_t count = frame.sample_counts[p];
+            const float scale = count > 0 ? 1.0f / count : 0.0f;
+            image.color_r[0][p] = frame.color[p * 3] * scale / (albedo[0] + albedo_offset);
+            image.color_g[0][p] = frame.color[p * 3 + 1] * scale / (albedo[1] + albedo_offset);
+            image.color_b[0][p] = frame.color[p * 3 + 2] * scale / (albedo[2] + albedo_offset);
+
+            // The statistics are of the radiance; the luminance of the albedo
+            // approximately carries them over to the demodulated color. A
+            // negative variance marks a pixel SpatialVariance fills in.
+            const PixelStats& stats = frame.stats[p];
+            const float demodulation = PlaneLuminance(albedo[0] + albedo_offset, albedo[1] + albedo_offset, albedo[2] + albedo_offset);
+            image.variance[0][p] = stats.count >= min_variance_samples
+                ? stats.m2 / (stats.count - 1) * scale / (demodulation * demodulation)
+                : -1.0f;
+        }
+    }
+
+    // Pixels with too few samples for their own estimate get the luminance variance of their neighbourhood
+    void SpatialVariance(DenoiseImage& image, int j)
+    {
+        for (int i = 0; i < image.width; ++i)
+        {
+            const size_t p = static_cast<size_t>(j) * image.width + i;
+            if (image.variance[0][p] >= 0.0f)
+            {
+                continue;
+            }
+
+            float sum = 0.0f;
+            float sum_squares = 0.0f;
+            int n = 0;
+            for (int y = std::max(j - spatial_variance_radius, 0); y <= std::min(j + spatial_variance_radius, image.height - 1); ++y)
+            {
+                for (int x = std::max(i - spatial_variance_radius, 0); x <= std::min(i + spatial_variance_radius, image.width - 1); ++x)
+                {
+                    const size_t q = static_cast<size_t>(y) * image.width + x;
+                    if (image.weight[q] == 0.0f)
+                    {
+                        continue;
+                    }
+                    const float luminance = PlaneLuminance(image.color_r[0][q], image.color_g[0][q], image.color_b[0][q]);
+                    sum += luminance;
+                    sum_squares += luminance * luminance;
+                    ++n;
+                }
+            }
+            const float mean = sum / n;
+            image.variance[1][p] = std::max(sum_squares / n - mean * mean, 0.0f);
+        }
+    }
+}
+
+void Denoise(FrameBuffer& frame, ThreadPool& threads, SimdLevel level)
+{
+    const int width = frame.width;
+    const int height = frame.height;
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+
+    DenoiseImage image;
+    image.width = width;
+    image.height = height;
+    for (auto* plane : { &image.normal_x, &image.normal_y, &image.normal_z, &image.depth, &image.albedo_r, &image.albedo_g, &image.albedo_b, &image.weight,
+        &image.color_r[0], &image.color_g[0], &image.color_b[0], &image.variance[0],
+        &image.color_r[1], &image.color_g[1], &image.color_b[1], &image.variance[1] })
+    {
+        plane->assign(pixel_count, 0.0f);
+    }
+
+    ForEachRow(height, threads, [&](int j) { LoadRow(frame, image, j); });
+    // Written to the second set first, so the estimates read only measured neighbours
+    ForEachRow(height, threads, [&](int j) { SpatialVariance(image, j); });
+    for (size_t p = 0; p < pixel_count; ++p)
+    {
+        if (image.variance[0][p] < 0.0f)
+        {
+            image.variance[0][p] = image.variance[1][p];
+        }
+    }
+
+    const DenoiseRowKernel filter_row = DenoiserKernels::Select(level);
+    int current = 0;
+    for (int pass_index = 0; pass_index < pass_count; ++pass_index)
+    {
+        const int next = 1 - current;
+        const DenoisePass pass = { width, height, 1 << pass_index,
+            image.normal_x.data(), image.normal_y.data(), image.normal_z.data(), image.depth.data(),
+            image.albedo_r.data(), image.albedo_g.data(), image.albedo_b.data(), image.weight.data(),
+            image.color_r[current].data(), image.color_g[current].data(), image.color_b[current].data(), image.variance[current].data(),
+            image.color_r[next].data(), image.color_g[next].data(), image.color_b[next].data(), image.variance[next].data() };
+        ForEachRow(height, threads, [&](int j) { filter_row(pass, j); });
+        current = next;
+    }
+
+    // Remodulate and scale back to sums
+    ForEachRow(height, threads, [&](int j)
+        {
+            for (int i = 0; i < width; ++i)
+            {
+                const size_t p = static_cast<size_t>(j) * width + i;
+                const float count = static_cast<float>(frame.sample_counts[p]);
+                frame.color[p * 3] = image.color_r[current][p] * (image.albedo_r[p] + albedo_offset) * count;
+                frame.color[p * 3 + 1] = image.color_g[current][p] * (image.albedo_g[p] + albedo_offset) * count;
+                frame.color[p * 3 + 2] = image.color_b[current][p] * (image.albedo_b[p] + albedo_offset) * count;
+            }
+        });
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FrameBuffer.h"
+#include "../CpuFeatures.h"
+#include "../ThreadPool/ThreadPool.h"
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) with the
+// variance-guided luminance weight of SVGF (Schied et al. 2017), for frames
+// rendered at a few samples per pixel.
+//
+// Radiance is divided by the first-hit albedo before filtering and multiplied
+// back after, so texture and material edges stay sharp and only the lighting
+// is smoothed. Five passes of a 5x5 kernel with taps 1, 2, 4, 8 and 16 pixels
+// apart cover a 125-pixel footprint. Each tap is weighted by how far its
+// luminance is from the center relative to the center's estimated noise, and
+// by its normal, depth and albedo difference.
+//
+// The frame must track stats and features. Color sums are replaced by
+// denoised ones, still scaled by each pixel's sample count, so image writers
+// need no change. Rows of each pass are spread over the pool.
+void Denoise(FrameBuffer& frame, ThreadPool& threads, SimdLevel level = ActiveSimdLevel());
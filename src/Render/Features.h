@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Background.h"
+#include "../Objects/Hittable.h"
+#include "../Ray.h"
+#include "../Vector3Float.h"
+
+// First-hit surface attributes of one sample. They guide the denoiser, which
+// must not blur across edges that these show but the noisy radiance hides.
+struct FeatureSample
+{
+    Vector3 albedo = Vector3(0, 0, 0);   // Attenuation of the first scatter; the sky color on a miss
+    Vector3 normal = Vector3(0, 0, 0);   // Zero on a miss
+    float depth = 0.0f;                  // Distance to the first hit; 0 on a miss
+};
+
+inline FeatureSample Hit_features(const Ray& r, const HitRecord& rec, bool scatters, const Vector3& attenuation)
+{
+    FeatureSample feature;
+    if (scatters)
+    {
+        feature.albedo = attenuation;
+    }
+    feature.normal = rec.normal;
+    feature.depth = rec.t * r.GetDirection().GetLength();
+    return feature;
+}
+
+inline FeatureSample Miss_features(const Ray& r)
+{
+    FeatureSample feature;
+    feature.albedo = Sky_color(r);
+    return feature;
+}
+
+// Per-pixel sums of the feature samples, kept apart from the sample count
+// because a resumed frame only has features for the samples taken since
+struct PixelFeatures
+{
+    float albedo[3] = { 0.0f, 0.0f, 0.0f };
+    float normal[3] = { 0.0f, 0.0f, 0.0f };
+    float depth = 0.0f;
+    float count = 0.0f;
+
+    void Add(const FeatureSample& feature)
+    {
+        albedo[0] += feature.albedo.r;
+        albedo[1] += feature.albedo.g;
+        albedo[2] += feature.albedo.b;
+        normal[0] += feature.normal.x;
+        normal[1] += feature.normal.y;
+        normal[2] += feature.normal.z;
+        depth += feature.depth;
+        count += 1.0f;
+    }
+};
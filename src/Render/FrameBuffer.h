@@ -0,0 +1,156 @@
+#pragma once
+
+#include "AdaptiveSampling.h"
+#include "Features.h"
+#include "Tile.h"
+#include "../Vector3Float.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Leaves elements a vector is resized with uninitialized instead of zeroing
+// them, so the memory is first written by whichever thread fills it
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T>
+{
+    template <typename U>
+    struct rebind
+    {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    using std::allocator<T>::allocator;
+
+    template <typename U>
+    void construct(U* p)
+    {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+// Unnormalized per-pixel radiance sums plus the number of samples behind each sum.
+// A frame that starts out nonzero (a resumed checkpoint) is continued: the
+// renderer adds each pixel's next samples to the sum already there.
+struct FrameBuffer
+{
+    // track_stats keeps every pixel's adaptive sampling statistics, which a
+    // checkpoint needs to resume an adaptive render exactly. track_features
+    // keeps the first-hit features the denoiser is guided by. A frame that
+    // is not zeroed has undefined radiance and sample counts until ClearTile
+    // has covered every pixel; the pages are then placed on the NUMA node of
+    // the threads that cleared them.
+    FrameBuffer(int _width, int _height, bool track_stats = false, bool track_features = false, bool zeroed = true)
+        : width(_width), height(_height), cleared(zeroed)
+    {
+        if (zeroed)
+        {
+            color.resize(static_cast<size_t>(_width) * _height * 3, 0.0f);
+            sample_counts.resize(static_cast<size_t>(_width) * _height, 0);
+        }
+        else
+        {
+            color.resize(static_cast<size_t>(_width) * _height * 3);
+            sample_counts.resize(static_cast<size_t>(_width) * _height);
+        }
+        if (track_stats)
+        {
+            stats.resize(static_cast<size_t>(_width) * _height);
+        }
+        if (track_features)
+        {
+            features.resize(static_cast<size_t>(_width) * _height);
+        }
+    }
+
+    void SetPixel(int i, int j, const Vector3& sum, uint32_t samples)
+    {
+        const size_t pixel = static_cast<size_t>(j) * width + i;
+        color[pixel * 3] = sum.r;
+        color[pixel * 3 + 1] = sum.g;
+        color[pixel * 3 + 2] = sum.b;
+        sample_counts[pixel] = samples;
+    }
+
+    void SetPixel(int i, int j, const Vector3& sum, uint32_t samples, const PixelStats& pixel_stats)
+    {
+        SetPixel(i, j, sum, samples);
+        if (!stats.empty())
+        {
+            stats[static_cast<size_t>(j) * width + i] = pixel_stats;
+        }
+    }
+
+    // Back to an empty frame, keeping what is tracked
+    void Clear()
+    {
+        std::fill(color.begin(), color.end(), 0.0f);
+        std::fill(sample_counts.begin(), sample_counts.end(), 0u);
+        std::fill(stats.begin(), stats.end(), PixelStats());
+        std::fill(features.begin(), features.end(), PixelFeatures());
+        cleared = true;
+    }
+
+    void ClearTile(const Tile& tile)
+    {
+        for (int j = tile.y0; j < tile.y1; ++j)
+        {
+            const size_t first = static_cast<size_t>(j) * width + tile.x0;
+            std::fill_n(color.begin() + first * 3, (tile.x1 - tile.x0) * 3, 0.0f);
+            std::fill_n(sample_counts.begin() + first, tile.x1 - tile.x0, 0u);
+        }
+    }
+
+    // Only the thread rendering the pixel may call this
+    void AddFeatures(int i, int j, const FeatureSample& feature)
+    {
+        features[static_cast<size_t>(j) * width + i].Add(feature);
+    }
+
+    bool HasFeatures() const
+    {
+        return !features.empty();
+    }
+
+    Vector3 GetSum(int i, int j) const
+    {
+        const size_t pixel = static_cast<size_t>(j) * width + i;
+        return Vector3(color[pixel * 3], color[pixel * 3 + 1], color[pixel * 3 + 2]);
+    }
+
+    uint32_t GetSampleCount(int i, int j) const
+    {
+        return sample_counts[static_cast<size_t>(j) * width + i];
+    }
+
+    // Empty statistics if they are not tracked
+    PixelStats GetStats(int i, int j) const
+    {
+        return stats.empty() ? PixelStats() : stats[static_cast<size_t>(j) * width + i];
+    }
+
+    uint64_t GetTotalSamples() const
+    {
+        uint64_t total = 0;
+        for (const uint32_t count : sample_counts)
+        {
+            total += count;
+        }
+        return total;
+    }
+
+    int width;
+    int height;
+    bool cleared;    // False for a frame built unzeroed until Renderer::FirstTouch has run; checked by debug builds
+    std::vector<float, DefaultInitAllocator<float>> color;
+    std::vector<uint32_t, DefaultInitAllocator<uint32_t>> sample_counts;
+    std::vector<PixelStats> stats;         // Empty unless tracked
+    std::vector<PixelFeatures> features;   // Empty unless tracked
+};
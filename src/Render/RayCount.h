@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Rays traced by the calling thread. Always on: one increment per ray is lost
+// in the noise next to the traversal it stands for.
+inline thread_local uint64_t thread_ray_count = 0;
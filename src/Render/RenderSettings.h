@@ -0,0 +1,366 @@
+#pragma once
+
+#include "../CpuFeatures.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+enum class IntegratorType
+{
+    Recursive,
+    Wavefront
+};
+
+enum class ImageFormat
+{
+    PPM,    // Binary 8-bit, gamma 2
+    PFM     // Linear 32-bit float
+};
+
+// Where the rendered scene comes from
+enum class SceneSource : uint32_t
+{
+    Builtin,     // The scene name is a Make_scene name
+    SceneFile,   // The scene name is a path
+    Obj
+};
+
+struct RenderSettings
+{
+    int image_width = 1000;
+    int image_height = 1000;
+    int samples_per_pixel = 20;
+    int max_depth = 30;
+    bool russian_roulette = false;      // End dim paths early, without bias
+    int roulette_min_depth = 3;         // Bounces before roulette may end a path
+    bool adaptive_sampling = false;     // samples_per_pixel becomes the per-pixel maximum
+    float adaptive_threshold = 0.02f;   // Relative standard error at which a pixel stops
+    int min_samples_per_pixel = 16;
+    int adaptive_batch = 4;             // Samples taken between convergence checks
+    int tile_size = 32;
+    uint32_t thread_count = 0;   // 0 uses every hardware thread
+    bool pin_threads = false;                       // Pin each worker to a CPU, one NUMA node after another
+    const char* cpu_list = nullptr;                 // CPUs to pin the workers to, as in "0-15,32-47"
+    bool numa_placement = false;                    // Each worker renders one block of tiles, in memory it placed
+    const char* image_name = "image.ppm";
+    const char* builtin_scene = "random";           // Make_scene name, used without a scene or OBJ file
+    const char* scene_file = nullptr;               // Binary scene to render instead of the built-in one
+    const char* obj_file = nullptr;                 // OBJ mesh to render instead of the built-in scene
+    const char* convert_text = nullptr;             // With convert_output: convert this text scene and exit
+    const char* convert_output = nullptr;
+    bool store_scene_bvh = true;                    // Whether converted scenes carry a prebuilt BVH
+    ImageFormat image_format = ImageFormat::PPM;
+    IntegratorType integrator = IntegratorType::Recursive;
+    bool packet_tracing = true;                     // Trace primary rays in 4x2 pixel packets
+    SimdLevel max_simd_level = SimdLevel::AVX512;   // Capped to what the CPU supports
+    const char* worker_addresses = nullptr;         // "host:port,..." to render on instead of locally
+    int worker_port = 0;                            // Nonzero: serve render jobs on this port
+    const char* resume_file = nullptr;              // Checkpoint whose samples the render continues from
+    const char* checkpoint_file = nullptr;          // Where to save the accumulated samples
+    int checkpoint_interval = 0;                    // Seconds between checkpoints during a render; 0 saves only at the end
+    bool denoise = false;                           // Filter the frame guided by first-hit features before output
+    const char* animation_file = nullptr;           // Keyframes of a sequence to render instead of one frame
+    bool stream_output = true;                      // Write the image band by band as tiles finish
+
+    float GetAspectRatio() const
+    {
+        return static_cast<float>(image_width) / image_height;
+    }
+
+    SceneSource GetSceneSource() const
+    {
+        return scene_file ? SceneSource::SceneFile : obj_file ? SceneSource::Obj : SceneSource::Builtin;
+    }
+
+    const char* GetSceneName() const
+    {
+        return scene_file ? scene_file : obj_file ? obj_file : builtin_scene;
+    }
+};
+
+inline void PrintUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+        << "  --width N        image width (default 1000)\n"
+        << "  --height N       image height (default 1000)\n"
+        << "  --spp N          samples per pixel (default 20)\n"
+        << "  --depth N        max bounce depth (default 30)\n"
+        << "  --roulette N     end dim paths by Russian roulette after N bounces (default off)\n"
+        << "  --adaptive E     stop pixels once their relative error drops below E;\n"
+        << "                   --spp is then the per-pixel maximum\n"
+        << "  --min-spp N      samples before adaptive stopping is considered (default 16)\n"
+        << "  --tile-size N    tile edge in pixels (default 32)\n"
+        << "  --threads N      worker threads, 0 for all cores (default 0)\n"
+        << "  --pin on|off     pin each worker thread to a CPU of its own, filling one NUMA\n"
+        << "                   node before the next (default off)\n"
+        << "  --cpus LIST      pin the workers to these CPUs, e.g. 0-15,32-47; --threads\n"
+        << "                   defaults to their count\n"
+        << "  --numa on|off    give each worker a contiguous block of tiles and place its\n"
+        << "                   part of the frame in its node's memory; pins (default off)\n"
+        << "  --output FILE    output image (default image.ppm)\n"
+        << "  --format ppm|pfm output encoding (default: from the --output extension, else ppm)\n"
+        << "  --builtin NAME   built-in scene: random, dense, glass or instanced (default random)\n"
+        << "  --scene FILE     render a binary scene file instead of the built-in scene\n"
+        << "  --obj FILE       render an OBJ mesh on a ground plane instead of the built-in scene\n"
+        << "  --convert-scene TEXT FILE\n"
+        << "                   convert a text scene description to a binary scene file and exit\n"
+        << "  --scene-bvh on|off\n"
+        << "                   store a prebuilt BVH in converted scenes (default on)\n"
+        << "  --integrator recursive|wavefront\n"
+        << "                   path tracing loop (default recursive)\n"
+        << "  --packets on|off primary ray packets (default on)\n"
+        << "  --simd LEVEL     widest kernels to use: scalar, avx2 or avx512 (default avx512)\n"
+        << "  --workers HOST:PORT[,HOST:PORT...]\n"
+        << "                   render on these workers and merge their tiles here\n"
+        << "  --worker PORT    serve render jobs on PORT until stopped; only --threads applies\n"
+        << "  --resume FILE    continue from the samples saved in a checkpoint; --spp is the new total\n"
+        << "  --checkpoint FILE\n"
+        << "                   save the accumulated samples to FILE when the render ends\n"
+        << "  --checkpoint-every N\n"
+        << "                   also save the finished tiles every N seconds during the render\n"
+        << "  --denoise on|off filter the noise out of the frame before writing it (default off)\n"
+        << "  --stream on|off  write the image band by band while it renders (default on;\n"
+        << "                   a denoised frame is always written once finished)\n"
+        << "  --animation FILE render the frames of an animation; each frame's number is\n"
+        << "                   added to the --output name before its extension\n";
+}
+
+// Returns false on unknown or malformed options
+inline bool ParseArguments(int argc, char** argv, RenderSettings& settings)
+{
+    bool format_given = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        auto read_int = [&](int& out, int min_value)
+        {
+            if (!value)
+            {
+                return false;
+            }
+            out = std::atoi(value);
+            ++i;
+            return out >= min_value;
+        };
+
+        auto read_float = [&](float& out)
+        {
+            if (!value)
+            {
+                return false;
+            }
+            out = static_cast<float>(std::atof(value));
+            ++i;
+            return out > 0.0f;
+        };
+
+        int number = 0;
+        if (std::strcmp(arg, "--width") == 0)
+        {
+            if (!read_int(settings.image_width, 1)) return false;
+        }
+        else if (std::strcmp(arg, "--height") == 0)
+        {
+            if (!read_int(settings.image_height, 1)) return false;
+        }
+        else if (std::strcmp(arg, "--spp") == 0)
+        {
+            if (!read_int(settings.samples_per_pixel, 1)) return false;
+        }
+        else if (std::strcmp(arg, "--depth") == 0)
+        {
+            if (!read_int(settings.max_depth, 1)) return false;
+        }
+        else if (std::strcmp(arg, "--roulette") == 0)
+        {
+            if (!read_int(settings.roulette_min_depth, 0)) return false;
+            settings.russian_roulette = true;
+        }
+        else if (std::strcmp(arg, "--adaptive") == 0)
+        {
+            if (!read_float(settings.adaptive_threshold)) return false;
+            settings.adaptive_sampling = true;
+        }
+        else if (std::strcmp(arg, "--min-spp") == 0)
+        {
+            if (!read_int(settings.min_samples_per_pixel, 2)) return false;
+        }
+        else if (std::strcmp(arg, "--tile-size") == 0)
+        {
+            if (!read_int(settings.tile_size, 1)) return false;
+        }
+        else if (std::strcmp(arg, "--threads") == 0)
+        {
+            if (!read_int(number, 0)) return false;
+            settings.thread_count = static_cast<uint32_t>(number);
+        }
+        else if (std::strcmp(arg, "--pin") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "on") == 0) settings.pin_threads = true;
+            else if (std::strcmp(value, "off") == 0) settings.pin_threads = false;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--cpus") == 0)
+        {
+            if (!value) return false;
+            settings.cpu_list = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--numa") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "on") == 0) settings.numa_placement = true;
+            else if (std::strcmp(value, "off") == 0) settings.numa_placement = false;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--output") == 0)
+        {
+            if (!value) return false;
+            settings.image_name = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--format") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "ppm") == 0) settings.image_format = ImageFormat::PPM;
+            else if (std::strcmp(value, "pfm") == 0) settings.image_format = ImageFormat::PFM;
+            else return false;
+            format_given = true;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--builtin") == 0)
+        {
+            if (!value) return false;
+            settings.builtin_scene = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--scene") == 0)
+        {
+            if (!value) return false;
+            settings.scene_file = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--obj") == 0)
+        {
+            if (!value) return false;
+            settings.obj_file = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--convert-scene") == 0)
+        {
+            if (!value || i + 2 >= argc) return false;
+            settings.convert_text = value;
+            settings.convert_output = argv[i + 2];
+            i += 2;
+        }
+        else if (std::strcmp(arg, "--scene-bvh") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "on") == 0) settings.store_scene_bvh = true;
+            else if (std::strcmp(value, "off") == 0) settings.store_scene_bvh = false;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--integrator") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "recursive") == 0) settings.integrator = IntegratorType::Recursive;
+            else if (std::strcmp(value, "wavefront") == 0) settings.integrator = IntegratorType::Wavefront;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--packets") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "on") == 0) settings.packet_tracing = true;
+            else if (std::strcmp(value, "off") == 0) settings.packet_tracing = false;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--animation") == 0)
+        {
+            if (!value) return false;
+            settings.animation_file = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--denoise") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "on") == 0) settings.denoise = true;
+            else if (std::strcmp(value, "off") == 0) settings.denoise = false;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--stream") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "on") == 0) settings.stream_output = true;
+            else if (std::strcmp(value, "off") == 0) settings.stream_output = false;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--simd") == 0)
+        {
+            if (!value) return false;
+            if (std::strcmp(value, "scalar") == 0) settings.max_simd_level = SimdLevel::Scalar;
+            else if (std::strcmp(value, "avx2") == 0) settings.max_simd_level = SimdLevel::AVX2;
+            else if (std::strcmp(value, "avx512") == 0) settings.max_simd_level = SimdLevel::AVX512;
+            else return false;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--workers") == 0)
+        {
+            if (!value) return false;
+            settings.worker_addresses = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--worker") == 0)
+        {
+            if (!read_int(settings.worker_port, 1) || settings.worker_port > 65535) return false;
+        }
+        else if (std::strcmp(arg, "--resume") == 0)
+        {
+            if (!value) return false;
+            settings.resume_file = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--checkpoint") == 0)
+        {
+            if (!value) return false;
+            settings.checkpoint_file = value;
+            ++i;
+        }
+        else if (std::strcmp(arg, "--checkpoint-every") == 0)
+        {
+            if (!read_int(settings.checkpoint_interval, 1)) return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (settings.checkpoint_interval > 0 && !settings.checkpoint_file)
+    {
+        std::cerr << "--checkpoint-every requires --checkpoint" << std::endl;
+        return false;
+    }
+
+    if (!format_given)
+    {
+        const size_t length = std::strlen(settings.image_name);
+        if (length >= 4 && std::strcmp(settings.image_name + length - 4, ".pfm") == 0)
+        {
+            settings.image_format = ImageFormat::PFM;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,264 @@
+#include "Renderer.h"
+#include "AdaptiveSampling.h"
+#include "Background.h"
+#include "RayCount.h"
+#include "RussianRoulette.h"
+#include "../Counters.h"
+
+#include <cassert>
+#include <latch>
+#include <vector>
+
+void Renderer::Render(ThreadPool& threads, const std::function<void(int)>& on_progress, const std::function<void(const Tile&)>& on_tile_done)
+{
+    RenderTiles(threads, MakeTiles(settings.image_width, settings.image_height, settings.tile_size), on_progress, on_tile_done);
+}
+
+void Renderer::RenderTiles(ThreadPool& threads, const std::vector<Tile>& tiles, const std::function<void(int)>& on_progress, const std::function<void(const Tile&)>& on_tile_done)
+{
+    assert(frame.cleared && "a frame built unzeroed needs FirstTouch before it is rendered");
+
+    std::function<uint32_t(int)> place;
+    if (settings.numa_placement)
+    {
+        const uint32_t worker_count = threads.GetThreadCount();
+        place = [&tiles, worker_count](int k) { return GetTileWorker(k, tiles.size(), worker_count); };
+    }
+
+    // The batch counts finished tiles rather than queued jobs, so no tile is
+    // still in flight when this returns and the frame can be read straight away
+    threads.QueueBatch(static_cast<int>(tiles.size()), [this, &tiles, &on_tile_done](int k)
+        {
+            RenderTile(tiles[k]);
+            if (on_tile_done)
+            {
+                on_tile_done(tiles[k]);
+            }
+        }, place)->Wait(on_progress);
+}
+
+void Renderer::FirstTouch(ThreadPool& threads, const std::vector<Tile>& tiles)
+{
+    assert(!frame.cleared && "FirstTouch is for a frame built unzeroed");
+
+    const uint32_t worker_count = threads.GetThreadCount();
+    std::latch started(worker_count);
+    threads.QueueBatch(static_cast<int>(worker_count), [this, &tiles, &started, worker_count](int)
+        {
+            // Every worker holds one of these jobs before any goes on, so
+            // none can steal a second, and each clears its own tiles
+            started.arrive_and_wait();
+            const uint32_t worker = ThreadPool::GetCurrentWorker();
+            for (size_t k = 0; k < tiles.size(); ++k)
+            {
+                if (GetTileWorker(k, tiles.size(), worker_count) == worker)
+                {
+                    frame.ClearTile(tiles[k]);
+                }
+            }
+        }, [](int w) { return static_cast<uint32_t>(w); })->Wait();
+    frame.cleared = true;
+}
+
+void Renderer::RenderTile(const Tile& tile)
+{
+    const uint64_t rays_before = thread_ray_count;
+
+    if (settings.integrator == IntegratorType::Wavefront)
+    {
+        integrator.RenderTile(tile, frame);
+    }
+    else if (settings.packet_tracing)
+    {
+        for (int j = tile.y0; j < tile.y1; j += 2)
+        {
+            for (int i = tile.x0; i < tile.x1; i += 4)
+            {
+                Pixel_block_color(i, j, tile);
+            }
+        }
+    }
+    else
+    {
+        for (int j = tile.y0; j < tile.y1; ++j)
+        {
+            for (int i = tile.x0; i < tile.x1; ++i)
+            {
+                Pixel_color(i, j);
+            }
+        }
+    }
+
+    ray_count.fetch_add(thread_ray_count - rays_before, std::memory_order_relaxed);
+}
+
+Vector3 Renderer::Shade_hit(const Ray& r, const HitRecord& rec, int depth, const Vector3& throughput, FeatureSample* first_hit) const
+{
+    Ray scattered;
+    Vector3 attenuation;
+
+    const MaterialType type = scene.materials.GetType(rec.mat_id);
+    const bool scatters = scene.materials.Scatter(rec.mat_id, r, rec, attenuation, scattered);
+    RT_COUNT(Counters::Local().AddScatter(type, scatters));
+    if (first_hit)
+    {
+        *first_hit = Hit_features(r, rec, scatters, attenuation);
+    }
+    if (scatters)
+    {
+        const Vector3 path_throughput = throughput * attenuation;
+        const float survival = Roulette(settings, settings.max_depth - depth, path_throughput, type);
+        if (survival == 0.0f)
+        {
+            RT_COUNT(++Counters::Local().roulette_terminations);
+            return Vector3(0, 0, 0);
+        }
+        return (attenuation / survival) * Ray_color(scattered, depth - 1, path_throughput / survival);
+    }
+
+    return Vector3(0, 0, 0);
+}
+
+Vector3 Renderer::Ray_color(const Ray& r, int depth, const Vector3& throughput, FeatureSample* first_hit) const
+{
+    HitRecord rec;
+
+    if (depth <= 0)
+    {
+        RT_COUNT(++Counters::Local().depth_terminations);
+        return Vector3(0, 0, 0);
+    }
+
+    ++thread_ray_count;
+    RT_COUNT(Counters::Local().AddRays(settings.max_depth - depth));
+    if (world.Hit(r, 0.001f, infinity, rec))
+    {
+        return Shade_hit(r, rec, depth, throughput, first_hit);
+    }
+
+    if (first_hit)
+    {
+        *first_hit = Miss_features(r);
+    }
+    return Sky_color(r);
+}
+
+void Renderer::Pixel_color(int i, int j)
+{
+    // Zero unless the frame was resumed from a checkpoint
+    Vector3 color = frame.GetSum(i, j);
+    PixelStats stats = frame.GetStats(i, j);
+    int s = static_cast<int>(frame.GetSampleCount(i, j));
+
+    const uint64_t pixel_index = static_cast<uint64_t>(j) * settings.image_width + i;
+    FeatureSample feature;
+    FeatureSample* const first_hit = frame.HasFeatures() ? &feature : nullptr;
+
+    while (!Is_pixel_done(stats, s, settings))
+    {
+        SeedRandom(pixel_index, s);
+        const auto u = (i + random_float()) / settings.image_width;
+        const auto v = (j + random_float()) / settings.image_height;
+        Ray r = camera.GetRay(u, v);
+        const Vector3 sample = Ray_color(r, settings.max_depth, Vector3(1, 1, 1), first_hit);
+        if (first_hit)
+        {
+            frame.AddFeatures(i, j, feature);
+        }
+        color += sample;
+        stats.Add(sample);
+        ++s;
+    }
+    frame.SetPixel(i, j, color, s, stats);
+}
+
+// Traces one sample for each pixel of a 4x2 block as a packet. Only the primary
+// hit is shared; every lane then continues with the single-ray Ray_color.
+void Renderer::Pixel_block_color(int x, int y, const Tile& tile)
+{
+    constexpr int block_width = 4;
+
+    int pixel_i[RayPacket::size];
+    int pixel_j[RayPacket::size];
+    uint32_t active = 0;
+    Vector3 colors[RayPacket::size];
+    PixelStats stats[RayPacket::size];
+    int taken[RayPacket::size];   // Per lane: resumed pixels may start at different counts
+
+    for (int lane = 0; lane < RayPacket::size; ++lane)
+    {
+        pixel_i[lane] = x + lane % block_width;
+        pixel_j[lane] = y + lane / block_width;
+        if (pixel_i[lane] < tile.x1 && pixel_j[lane] < tile.y1)
+        {
+            colors[lane] = frame.GetSum(pixel_i[lane], pixel_j[lane]);
+            stats[lane] = frame.GetStats(pixel_i[lane], pixel_j[lane]);
+            taken[lane] = static_cast<int>(frame.GetSampleCount(pixel_i[lane], pixel_j[lane]));
+            if (!Is_pixel_done(stats[lane], taken[lane], settings))
+            {
+                active |= 1u << lane;
+            }
+        }
+    }
+
+    while (active != 0)
+    {
+        Pcg32 lane_rng[RayPacket::size];
+        float u[RayPacket::size];
+        float v[RayPacket::size];
+
+        for (int lane = 0; lane < RayPacket::size; ++lane)
+        {
+            if (active & (1u << lane))
+            {
+                SeedRandom(static_cast<uint64_t>(pixel_j[lane]) * settings.image_width + pixel_i[lane], taken[lane]);
+                u[lane] = (pixel_i[lane] + random_float()) / settings.image_width;
+                v[lane] = (pixel_j[lane] + random_float()) / settings.image_height;
+                lane_rng[lane] = thread_rng;
+            }
+        }
+
+        RayPacket packet;
+        camera.GetRayPacket(u, v, active, lane_rng, packet);
+
+        HitRecord recs[RayPacket::size];
+        float lane_t_max[RayPacket::size];
+        for (float& t : lane_t_max)
+        {
+            t = infinity;
+        }
+        const uint32_t hit_lanes = world.HitPacket(packet, active, 0.001f, lane_t_max, recs);
+        const bool record_features = frame.HasFeatures();
+
+        for (int lane = 0; lane < RayPacket::size; ++lane)
+        {
+            if (!(active & (1u << lane)))
+            {
+                continue;
+            }
+
+            ++thread_ray_count;
+            RT_COUNT(Counters::Local().AddRays(0));
+            thread_rng = lane_rng[lane];
+            const Ray r = packet.GetRay(lane);
+            FeatureSample feature;
+            const Vector3 sample = (hit_lanes & (1u << lane))
+                ? Shade_hit(r, recs[lane], settings.max_depth, Vector3(1, 1, 1), record_features ? &feature : nullptr)
+                : Sky_color(r);
+            if (record_features)
+            {
+                frame.AddFeatures(pixel_i[lane], pixel_j[lane], (hit_lanes & (1u << lane)) ? feature : Miss_features(r));
+            }
+            colors[lane] += sample;
+            stats[lane].Add(sample);
+            ++taken[lane];
+
+            // Converged lanes drop out of the packet
+            if (Is_pixel_done(stats[lane], taken[lane], settings))
+            {
+                active &= ~(1u << lane);
+                frame.SetPixel(pixel_i[lane], pixel_j[lane], colors[lane], taken[lane], stats[lane]);
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "FrameBuffer.h"
+#include "RenderSettings.h"
+#include "Tile.h"
+#include "WavefrontIntegrator.h"
+#include "../Camera.h"
+#include "../Scene.h"
+#include "../ThreadPool/ThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Renders a scene into a FrameBuffer tile by tile with the integrator and
+// tracing mode picked in the settings
+class Renderer
+{
+public:
+    Renderer(const RenderSettings& _settings, const Camera& _camera, const Scene& _scene, const Hittable& _world, FrameBuffer& _frame)
+        : settings(_settings), camera(_camera), scene(_scene), world(_world), frame(_frame), integrator(_camera, _world, _scene.materials, _settings)
+    {
+    }
+
+    // Queues every tile on the pool and returns once all of them are finished.
+    // on_progress, if set, gets the number of unfinished tiles every 200 ms.
+    // on_tile_done, if set, is called on the worker thread as each tile finishes.
+    void Render(ThreadPool& threads, const std::function<void(int)>& on_progress = nullptr, const std::function<void(const Tile&)>& on_tile_done = nullptr);
+
+    // Same as Render for a subset of the frame's tiles
+    void RenderTiles(ThreadPool& threads, const std::vector<Tile>& tiles, const std::function<void(int)>& on_progress = nullptr,
+        const std::function<void(const Tile&)>& on_tile_done = nullptr);
+
+    void RenderTile(const Tile& tile);
+
+    // Zeroes a frame created unzeroed, each tile on the worker NUMA placement
+    // will render it on, so the frame's pages land on that worker's node.
+    // tiles must be the list the frame is then rendered with.
+    void FirstTouch(ThreadPool& threads, const std::vector<Tile>& tiles);
+
+    // Rays traced by all tiles so far, camera rays included
+    uint64_t GetRayCount() const
+    {
+        return ray_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    // throughput is the product of the attenuations along the path so far,
+    // which Russian roulette bases its decision on. first_hit, if set, gets
+    // the features of the surface r hits; deeper bounces pass nullptr.
+    Vector3 Ray_color(const Ray& r, int depth, const Vector3& throughput, FeatureSample* first_hit = nullptr) const;
+    Vector3 Shade_hit(const Ray& r, const HitRecord& rec, int depth, const Vector3& throughput, FeatureSample* first_hit = nullptr) const;
+    void Pixel_color(int i, int j);
+    void Pixel_block_color(int x, int y, const Tile& tile);
+
+    const RenderSettings& settings;
+    const Camera& camera;
+    const Scene& scene;
+    const Hittable& world;
+    FrameBuffer& frame;
+    WavefrontIntegrator integrator;
+    std::atomic<uint64_t> ray_count = 0;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "RenderSettings.h"
+#include "../Materials/Material.h"
+#include "../Vector3Float.h"
+
+#include <algorithm>
+
+// Russian roulette: past roulette_min_depth bounces a path continues with
+// probability p and has its throughput divided by p, which keeps the image
+// unbiased while paths that can add little light stop early.
+//
+// p is the largest channel of the throughput, so a surviving path's weight
+// never exceeds 1 and dim paths are the ones that end. Dielectric scatters
+// always survive: glass does not attenuate, so the decision waits for the
+// next surface instead of cutting a chain of refractions partway through.
+inline float Survival_probability(const Vector3& throughput, MaterialType type)
+{
+    if (type == MaterialType::Dielectric)
+    {
+        return 1.0f;
+    }
+    return std::min(1.0f, std::max({ throughput.r, throughput.g, throughput.b }));
+}
+
+// Called after a scatter with the path's new throughput. Returns the
+// probability the path survived with, 1 when roulette does not apply, or 0
+// if the path ends here. Draws a random number only when the path can end.
+inline float Roulette(const RenderSettings& settings, int bounce, const Vector3& throughput, MaterialType type)
+{
+    if (!settings.russian_roulette || bounce < settings.roulette_min_depth)
+    {
+        return 1.0f;
+    }
+
+    const float p = Survival_probability(throughput, type);
+    if (p >= 1.0f)
+    {
+        return 1.0f;
+    }
+    return random_float() < p ? p : 0.0f;
+}
@@ -0,0 +1,173 @@
+#include "Sequence.h"
+#include "Denoiser.h"
+#include "FrameBuffer.h"
+#include "Renderer.h"
+#include "../Objects/BVH.h"
+#include "../Objects/Instance.h"
+#include "../Output/ImageWriter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+    // Refit trees trace about as fast as fresh ones until their nodes have
+    // grown well past their built size; past this, rebuilding pays for itself
+    constexpr float max_refit_growth = 2.0f;
+
+    struct AnimatedObject
+    {
+        const Animation::ObjectTrack* track;
+        std::shared_ptr<Instance> instance;
+        Point3 pivot;
+    };
+
+    // The frame number goes before the extension, if the name has one
+    std::string GetFrameName(const char* image_name, int frame)
+    {
+        const std::string name = image_name;
+        const size_t slash = name.find_last_of("/\\");
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        {
+            dot = name.size();
+        }
+
+        char number[16];
+        std::snprintf(number, sizeof(number), "_%04d", frame);
+        return name.substr(0, dot) + number + name.substr(dot);
+    }
+
+    // Replaces each tracked object of the scene by an instance of it that frames can move
+    bool WrapAnimatedObjects(Scene& scene, const Animation& animation, std::vector<AnimatedObject>& animated, std::string& error)
+    {
+        std::vector<std::shared_ptr<Hittable>>& objects = scene.objects.objects;
+        const int object_count = static_cast<int>(objects.size());
+        std::vector<bool> taken(objects.size(), false);
+
+        for (const Animation::ObjectTrack& track : animation.tracks)
+        {
+            const int index = track.index < 0 ? object_count + track.index : track.index;
+            if (index < 0 || index >= object_count)
+            {
+                error = "object " + std::to_string(track.index) + " is not in the scene, which has " + std::to_string(object_count) + " objects";
+                return false;
+            }
+            if (taken[index])
+            {
+                error = "object " + std::to_string(track.index) + " is animated twice";
+                return false;
+            }
+            taken[index] = true;
+
+            const Point3 pivot = objects[index]->GetBoundingBox().GetCentroid();
+            auto instance = std::make_shared<Instance>(objects[index], Animation::GetTransform(track, 0, pivot));
+            objects[index] = instance;
+            animated.push_back({ &track, std::move(instance), pivot });
+        }
+        return true;
+    }
+
+    long long GetMilliseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    }
+}
+
+bool RenderSequence(const RenderSettings& settings, Scene& scene, const Animation& animation, ThreadPool& threads, std::string& error)
+{
+    std::vector<AnimatedObject> animated;
+    if (!WrapAnimatedObjects(scene, animation, animated, error))
+    {
+        return false;
+    }
+
+    const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    std::unique_ptr<BVH> world = std::make_unique<BVH>(scene.objects);
+    int rebuild_count = 0;
+
+    // Two frames are in flight: one tracing, the one before it being written.
+    // Writing runs on its own pool so it never waits behind tracing jobs.
+    const std::unique_ptr<ImageWriter> writer = MakeImageWriter(settings.image_format);
+    ThreadPool output_threads;
+    output_threads.Start(1);
+    FrameBuffer frames[2] = {
+        FrameBuffer(settings.image_width, settings.image_height, settings.denoise, settings.denoise),
+        FrameBuffer(settings.image_width, settings.image_height, settings.denoise, settings.denoise) };
+    std::future<bool> writes[2];
+    std::string names[2];
+
+    bool written = true;
+    for (int f = 0; f < animation.frame_count; ++f)
+    {
+        const std::chrono::steady_clock::time_point frame_begin = std::chrono::steady_clock::now();
+
+        // The buffer is free again once the frame two before this one is on disk
+        const int slot = f % 2;
+        if (writes[slot].valid() && !writes[slot].get())
+        {
+            error = "could not write " + names[slot];
+            written = false;
+            break;
+        }
+        FrameBuffer& frame = frames[slot];
+        frame.Clear();
+
+        if (f > 0 && !animated.empty())
+        {
+            for (const AnimatedObject& object : animated)
+            {
+                object.instance->SetTransform(Animation::GetTransform(*object.track, f, object.pivot));
+            }
+            if (world->Refit() > max_refit_growth)
+            {
+                world = std::make_unique<BVH>(scene.objects);
+                ++rebuild_count;
+            }
+        }
+
+        const Camera camera = animation.GetCamera(f, scene.camera).Create(settings.GetAspectRatio());
+        Renderer renderer(settings, camera, scene, *world, frame);
+        renderer.Render(threads, [f, &animation](int tiles_left)
+            {
+                std::cerr << "\r" << "Frame " << f + 1 << "/" << animation.frame_count << ", tiles left: " << tiles_left << "   " << std::flush;
+            });
+        if (settings.denoise)
+        {
+            Denoise(frame, threads);
+        }
+
+        names[slot] = GetFrameName(settings.image_name, f);
+        writes[slot] = std::async(std::launch::async, [&writer, &frame, &output_threads, name = names[slot]]
+            {
+                return writer->Write(frame, output_threads, name.c_str());
+            });
+
+        std::cerr << "\x1b[2K\r" << "Frame " << f + 1 << "/" << animation.frame_count << " traced in "
+            << GetMilliseconds(std::chrono::steady_clock::now() - frame_begin) << "ms" << std::endl;
+    }
+
+    for (int slot = 0; slot < 2; ++slot)
+    {
+        if (writes[slot].valid() && !writes[slot].get() && written)
+        {
+            error = "could not write " + names[slot];
+            written = false;
+        }
+    }
+    output_threads.Stop();
+    if (!written)
+    {
+        return false;
+    }
+
+    const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - begin;
+    const double hours = std::chrono::duration<double, std::ratio<3600>>(elapsed).count();
+    std::cerr << "Rendered " << animation.frame_count << " frames in " << GetMilliseconds(elapsed) << "ms"
+        << " (" << static_cast<long long>(animation.frame_count / hours) << " frames per hour, "
+        << rebuild_count << " BVH rebuilds)" << std::endl;
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "RenderSettings.h"
+#include "../Scene.h"
+#include "../Scenes/Animation.h"
+#include "../ThreadPool/ThreadPool.h"
+
+#include <string>
+
+// Renders every frame of an animation to its own image, named after
+// settings.image_name with the frame number before the extension
+// (out.ppm -> out_0000.ppm, out_0001.ppm, ...).
+//
+// Animated objects are wrapped in instances once and moved between frames;
+// the BVH over the scene is refit to their new bounds rather than rebuilt,
+// unless refitting has let it grow too loose. Frames are pipelined: while
+// frame N is tone-mapped and written on a thread of its own, frame N+1 is
+// already tracing on the pool. Samples are seeded by pixel and sample, so
+// the noise pattern holds still from frame to frame.
+//
+// Returns false and sets error on failure.
+bool RenderSequence(const RenderSettings& settings, Scene& scene, const Animation& animation, ThreadPool& threads, std::string& error);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct Tile
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Worker that renders tile k of tile_count under NUMA placement: each worker
+// gets one contiguous run of tiles, and with it a contiguous part of the frame
+inline uint32_t GetTileWorker(size_t k, size_t tile_count, uint32_t worker_count)
+{
+    return static_cast<uint32_t>(k * worker_count / tile_count);
+}
+
+inline std::vector<Tile> MakeTiles(int image_width, int image_height, int tile_size)
+{
+    std::vector<Tile> tiles;
+    tiles.reserve(((image_width + tile_size - 1) / tile_size) * ((image_height + tile_size - 1) / tile_size));
+
+    for (int y = 0; y < image_height; y += tile_size)
+    {
+        for (int x = 0; x < image_width; x += tile_size)
+        {
+            tiles.push_back({ x, y, std::min(x + tile_size, image_width), std::min(y + tile_size, image_height) });
+        }
+    }
+
+    return tiles;
+}
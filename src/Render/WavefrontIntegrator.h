@@ -0,0 +1,366 @@
+#pragma once
+
+#include "AdaptiveSampling.h"
+#include "Background.h"
+#include "FrameBuffer.h"
+#include "RayCount.h"
+#include "RenderSettings.h"
+#include "RussianRoulette.h"
+#include "Tile.h"
+#include "../Camera.h"
+#include "../Counters.h"
+#include "../Materials/Dielectric.h"
+#include "../Materials/Lambertian.h"
+#include "../Materials/MaterialTable.h"
+#include "../Materials/Metal.h"
+#include "../Objects/Hittable.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Live paths of one wave in structure-of-arrays form
+struct PathStates
+{
+    std::vector<float> origin_x, origin_y, origin_z;
+    std::vector<float> direction_x, direction_y, direction_z;
+    std::vector<float> throughput_r, throughput_g, throughput_b;
+    std::vector<uint32_t> path_id;   // Slot in the per-path radiance buffer
+    std::vector<Pcg32> rng;
+    size_t count = 0;
+
+    void Reserve(size_t n)
+    {
+        if (path_id.size() >= n)
+        {
+            return;
+        }
+        for (auto* v : { &origin_x, &origin_y, &origin_z, &direction_x, &direction_y, &direction_z, &throughput_r, &throughput_g, &throughput_b })
+        {
+            v->resize(n);
+        }
+        path_id.resize(n);
+        rng.resize(n);
+    }
+
+    Ray GetRay(size_t i) const
+    {
+        return Ray(Vector3(origin_x[i], origin_y[i], origin_z[i]), Vector3(direction_x[i], direction_y[i], direction_z[i]));
+    }
+
+    void Push(const Ray& r, const Vector3& throughput, uint32_t id, const Pcg32& path_rng)
+    {
+        const Vector3 origin = r.GetOrigin();
+        const Vector3 direction = r.GetDirection();
+        origin_x[count] = origin.x;
+        origin_y[count] = origin.y;
+        origin_z[count] = origin.z;
+        direction_x[count] = direction.x;
+        direction_y[count] = direction.y;
+        direction_z[count] = direction.z;
+        throughput_r[count] = throughput.r;
+        throughput_g[count] = throughput.g;
+        throughput_b[count] = throughput.b;
+        path_id[count] = id;
+        rng[count] = path_rng;
+        ++count;
+    }
+};
+
+// Iterative path tracer. A tile's paths advance together through the stages
+// generate -> extend -> shade (bucketed by material type) -> compact, one
+// bounce per iteration, instead of one recursive call stack per sample.
+// With adaptive sampling the tile is traced in rounds, each covering only
+// the pixels that have not converged yet. Pixels continue from the samples
+// already in the frame, so a resumed frame may start them at different counts.
+class WavefrontIntegrator
+{
+public:
+    WavefrontIntegrator(const Camera& _camera, const Hittable& _world, const MaterialTable& _materials, const RenderSettings& _settings)
+        : camera(_camera), world(_world), materials(_materials), settings(_settings)
+    {
+    }
+
+    void RenderTile(const Tile& tile, FrameBuffer& frame) const;
+
+private:
+    static constexpr int material_type_count = static_cast<int>(MaterialType::Custom) + 1;
+
+    struct Workspace
+    {
+        PathStates current;
+        PathStates next;
+        std::vector<HitRecord> hits;
+        std::vector<uint32_t> buckets[material_type_count];
+        std::vector<Vector3> radiance;        // One entry per path of the current round
+        std::vector<uint32_t> active_pixels;  // Tile-local indices of unconverged pixels
+        std::vector<uint32_t> first_path;     // Per active pixel, its first radiance slot; one extra at the end
+        std::vector<PixelStats> stats;
+        std::vector<Vector3> colors;
+        std::vector<int> taken;               // Samples per pixel so far
+        std::vector<FeatureSample> features;  // Per path of the current round, if the frame keeps features
+        bool record_features = false;
+    };
+
+    static Workspace& GetWorkspace()
+    {
+        // Reused across tiles so the stages never allocate in steady state
+        thread_local Workspace workspace;
+        return workspace;
+    }
+
+    int GetRoundEnd(int taken) const;
+    void Generate(const Tile& tile, Workspace& ws) const;
+    void Trace(Workspace& ws) const;
+    void Extend(Workspace& ws, bool coherent, bool first_bounce) const;
+    void ResolveHit(Workspace& ws, size_t i, bool hit, bool first_bounce) const;
+    template <typename T>
+    void Shade(MaterialType type, Workspace& ws, int bounce) const;
+    void Accumulate(const Tile& tile, Workspace& ws, FrameBuffer& frame) const;
+
+    const Camera& camera;
+    const Hittable& world;
+    const MaterialTable& materials;
+    const RenderSettings& settings;
+};
+
+inline void WavefrontIntegrator::RenderTile(const Tile& tile, FrameBuffer& frame) const
+{
+    Workspace& ws = GetWorkspace();
+
+    const int tile_width = tile.x1 - tile.x0;
+    const uint32_t pixel_count = static_cast<uint32_t>(tile_width * (tile.y1 - tile.y0));
+    ws.active_pixels.clear();
+    ws.record_features = frame.HasFeatures();
+    ws.stats.resize(pixel_count);
+    ws.colors.resize(pixel_count);
+    ws.taken.resize(pixel_count);
+    for (uint32_t p = 0; p < pixel_count; ++p)
+    {
+        const int i = tile.x0 + static_cast<int>(p) % tile_width;
+        const int j = tile.y0 + static_cast<int>(p) / tile_width;
+        ws.colors[p] = frame.GetSum(i, j);
+        ws.stats[p] = frame.GetStats(i, j);
+        ws.taken[p] = static_cast<int>(frame.GetSampleCount(i, j));
+        if (!Is_pixel_done(ws.stats[p], ws.taken[p], settings))
+        {
+            ws.active_pixels.push_back(p);
+        }
+    }
+
+    while (!ws.active_pixels.empty())
+    {
+        Generate(tile, ws);
+        Trace(ws);
+        Accumulate(tile, ws, frame);
+    }
+}
+
+// Sample count at the end of a pixel's next round. Rounds end exactly where
+// Is_pixel_done may stop a pixel, which a pixel resumed partway through a
+// batch relies on to be tested at the same counts as in one longer render.
+inline int WavefrontIntegrator::GetRoundEnd(int taken) const
+{
+    const int spp = settings.samples_per_pixel;
+    if (!settings.adaptive_sampling)
+    {
+        return spp;
+    }
+    if (taken < settings.min_samples_per_pixel)
+    {
+        return std::min(settings.min_samples_per_pixel, spp);
+    }
+    const int into_batch = (taken - settings.min_samples_per_pixel) % settings.adaptive_batch;
+    return std::min(taken + settings.adaptive_batch - into_batch, spp);
+}
+
+inline void WavefrontIntegrator::Trace(Workspace& ws) const
+{
+    for (int depth = settings.max_depth; depth > 0 && ws.current.count > 0; --depth)
+    {
+        RT_COUNT(Counters::Local().AddRays(settings.max_depth - depth, ws.current.count));
+
+        // Camera rays are generated pixel by pixel, so runs of 8 are coherent enough for packets
+        const bool first_bounce = depth == settings.max_depth;
+        Extend(ws, first_bounce && settings.packet_tracing, first_bounce);
+
+        ws.next.Reserve(ws.current.count);
+        ws.next.count = 0;
+        const int bounce = settings.max_depth - depth;
+        Shade<Lambertian>(MaterialType::Lambertian, ws, bounce);
+        Shade<Metal>(MaterialType::Metal, ws, bounce);
+        Shade<Dielectric>(MaterialType::Dielectric, ws, bounce);
+        Shade<Material>(MaterialType::Custom, ws, bounce);
+
+        std::swap(ws.current, ws.next);
+    }
+
+    // Paths still alive here ran out of depth and, like Ray_color, contribute nothing
+    RT_COUNT(Counters::Local().depth_terminations += ws.current.count);
+}
+
+inline void WavefrontIntegrator::Generate(const Tile& tile, Workspace& ws) const
+{
+    const int tile_width = tile.x1 - tile.x0;
+
+    ws.first_path.resize(ws.active_pixels.size() + 1);
+    uint32_t path_count = 0;
+    for (size_t k = 0; k < ws.active_pixels.size(); ++k)
+    {
+        const int taken = ws.taken[ws.active_pixels[k]];
+        ws.first_path[k] = path_count;
+        path_count += static_cast<uint32_t>(GetRoundEnd(taken) - taken);
+    }
+    ws.first_path[ws.active_pixels.size()] = path_count;
+
+    ws.current.Reserve(path_count);
+    ws.current.count = 0;
+    ws.radiance.assign(path_count, Vector3(0, 0, 0));
+    if (ws.record_features)
+    {
+        ws.features.resize(path_count);
+    }
+
+    const Vector3 one(1, 1, 1);
+    for (size_t k = 0; k < ws.active_pixels.size(); ++k)
+    {
+        const int i = tile.x0 + static_cast<int>(ws.active_pixels[k]) % tile_width;
+        const int j = tile.y0 + static_cast<int>(ws.active_pixels[k]) / tile_width;
+        const uint64_t pixel_index = static_cast<uint64_t>(j) * settings.image_width + i;
+        const int first_sample = ws.taken[ws.active_pixels[k]];
+        const int end_sample = first_sample + static_cast<int>(ws.first_path[k + 1] - ws.first_path[k]);
+
+        for (int s = first_sample; s < end_sample; ++s)
+        {
+            SeedRandom(pixel_index, s);
+            const auto u = (i + random_float()) / settings.image_width;
+            const auto v = (j + random_float()) / settings.image_height;
+            ws.current.Push(camera.GetRay(u, v), one, ws.first_path[k] + (s - first_sample), thread_rng);
+        }
+    }
+}
+
+inline void WavefrontIntegrator::ResolveHit(Workspace& ws, size_t i, bool hit, bool first_bounce) const
+{
+    const PathStates& paths = ws.current;
+    if (hit)
+    {
+        ws.buckets[static_cast<int>(materials.GetType(ws.hits[i].mat_id))].push_back(static_cast<uint32_t>(i));
+        return;
+    }
+
+    if (first_bounce && ws.record_features)
+    {
+        ws.features[paths.path_id[i]] = Miss_features(paths.GetRay(i));
+    }
+    const Vector3 sky = Sky_color(paths.GetRay(i));
+    ws.radiance[paths.path_id[i]] = Vector3(paths.throughput_r[i] * sky.r, paths.throughput_g[i] * sky.g, paths.throughput_b[i] * sky.b);
+}
+
+inline void WavefrontIntegrator::Extend(Workspace& ws, bool coherent, bool first_bounce) const
+{
+    const PathStates& paths = ws.current;
+    ws.hits.resize(paths.count);
+    thread_ray_count += paths.count;
+    for (auto& bucket : ws.buckets)
+    {
+        bucket.clear();
+    }
+
+    size_t i = 0;
+    if (coherent)
+    {
+        RayPacket packet;
+        float lane_t_max[RayPacket::size];
+        for (; i + RayPacket::size <= paths.count; i += RayPacket::size)
+        {
+            for (int lane = 0; lane < RayPacket::size; ++lane)
+            {
+                packet.SetRay(lane, paths.GetRay(i + lane));
+                lane_t_max[lane] = infinity;
+            }
+
+            const uint32_t hit_lanes = world.HitPacket(packet, RayPacket::all_lanes, 0.001f, lane_t_max, &ws.hits[i]);
+            for (int lane = 0; lane < RayPacket::size; ++lane)
+            {
+                ResolveHit(ws, i + lane, (hit_lanes & (1u << lane)) != 0, first_bounce);
+            }
+        }
+    }
+
+    for (; i < paths.count; ++i)
+    {
+        ResolveHit(ws, i, world.Hit(paths.GetRay(i), 0.001f, infinity, ws.hits[i]), first_bounce);
+    }
+}
+
+template <typename T>
+inline void WavefrontIntegrator::Shade(MaterialType type, Workspace& ws, int bounce) const
+{
+    const PathStates& paths = ws.current;
+
+    for (const uint32_t i : ws.buckets[static_cast<int>(type)])
+    {
+        const HitRecord& rec = ws.hits[i];
+        // T is final for the built-in types, so this call is resolved statically
+        const T& material = static_cast<const T&>(materials[rec.mat_id]);
+
+        thread_rng = paths.rng[i];
+        Ray scattered;
+        Vector3 attenuation;
+        const bool scatters = material.Scatter(paths.GetRay(i), rec, attenuation, scattered);
+        RT_COUNT(Counters::Local().AddScatter(type, scatters));
+        if (bounce == 0 && ws.record_features)
+        {
+            ws.features[paths.path_id[i]] = Hit_features(paths.GetRay(i), rec, scatters, attenuation);
+        }
+        if (scatters)
+        {
+            const Vector3 throughput(paths.throughput_r[i] * attenuation.r, paths.throughput_g[i] * attenuation.g, paths.throughput_b[i] * attenuation.b);
+            const float survival = Roulette(settings, bounce, throughput, type);
+            if (survival == 0.0f)
+            {
+                RT_COUNT(++Counters::Local().roulette_terminations);
+                continue;
+            }
+            ws.next.Push(scattered, throughput / survival, paths.path_id[i], thread_rng);
+        }
+    }
+}
+
+inline void WavefrontIntegrator::Accumulate(const Tile& tile, Workspace& ws, FrameBuffer& frame) const
+{
+    const int tile_width = tile.x1 - tile.x0;
+
+    size_t still_active = 0;
+    for (size_t k = 0; k < ws.active_pixels.size(); ++k)
+    {
+        const uint32_t p = ws.active_pixels[k];
+        const int i = tile.x0 + static_cast<int>(p) % tile_width;
+        const int j = tile.y0 + static_cast<int>(p) / tile_width;
+
+        // Sum in sample order, like Pixel_color
+        for (uint32_t path = ws.first_path[k]; path < ws.first_path[k + 1]; ++path)
+        {
+            const Vector3& sample = ws.radiance[path];
+            ws.colors[p] += sample;
+            ws.stats[p].Add(sample);
+            if (ws.record_features)
+            {
+                frame.AddFeatures(i, j, ws.features[path]);
+            }
+        }
+        ws.taken[p] += static_cast<int>(ws.first_path[k + 1] - ws.first_path[k]);
+
+        if (Is_pixel_done(ws.stats[p], ws.taken[p], settings))
+        {
+            frame.SetPixel(i, j, ws.colors[p], ws.taken[p], ws.stats[p]);
+        }
+        else
+        {
+            ws.active_pixels[still_active++] = p;
+        }
+    }
+    ws.active_pixels.resize(still_active);
+}
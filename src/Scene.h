@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Camera.h"
+#include "Materials/MaterialTable.h"
+#include "Objects/HittableList.h"
+
+// Where a scene is viewed from; the aspect ratio comes from the render settings
+struct CameraSetup
+{
+    Vector3 lookfrom;
+    Vector3 lookat;
+    Vector3 vup;
+    float vfov;
+    float aperture;
+    float focus_dist;
+
+    Camera Create(float aspect) const
+    {
+        return Camera(lookfrom, lookat, vup, vfov, aspect, aperture, focus_dist);
+    }
+};
+
+// A scene owns its geometry and the materials that geometry refers to
+struct Scene
+{
+    MaterialTable materials;
+    HittableList objects;
+    CameraSetup camera;
+
+    Camera CreateCamera(float aspect) const
+    {
+        return camera.Create(aspect);
+    }
+};
@@ -0,0 +1,156 @@
+#include "Animation.h"
+#include "TextParsing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    // Index of the last key at or before frame and the weight of the one after it
+    template <typename Key>
+    size_t FindSegment(const std::vector<Key>& keys, int frame, float& weight)
+    {
+        size_t k = 0;
+        while (k + 1 < keys.size() && keys[k + 1].frame <= frame)
+        {
+            ++k;
+        }
+        weight = 0.0f;
+        if (k + 1 < keys.size() && frame > keys[k].frame)
+        {
+            weight = static_cast<float>(frame - keys[k].frame) / static_cast<float>(keys[k + 1].frame - keys[k].frame);
+        }
+        return k;
+    }
+
+    Vector3 Lerp(const Vector3& a, const Vector3& b, float weight)
+    {
+        return a + weight * (b - a);
+    }
+
+    float Lerp(float a, float b, float weight)
+    {
+        return a + weight * (b - a);
+    }
+
+    // Keeps keys sorted; a second key for the same frame replaces the first
+    template <typename Key>
+    void InsertKey(std::vector<Key>& keys, const Key& key)
+    {
+        const auto it = std::lower_bound(keys.begin(), keys.end(), key, [](const Key& a, const Key& b) { return a.frame < b.frame; });
+        if (it != keys.end() && it->frame == key.frame)
+        {
+            *it = key;
+        }
+        else
+        {
+            keys.insert(it, key);
+        }
+    }
+}
+
+CameraSetup Animation::GetCamera(int frame, const CameraSetup& scene_camera) const
+{
+    if (camera_keys.empty())
+    {
+        return scene_camera;
+    }
+
+    float weight;
+    const size_t k = FindSegment(camera_keys, frame, weight);
+    if (weight == 0.0f)
+    {
+        return camera_keys[k].camera;
+    }
+    const CameraSetup& a = camera_keys[k].camera;
+    const CameraSetup& b = camera_keys[k + 1].camera;
+    return { Lerp(a.lookfrom, b.lookfrom, weight), Lerp(a.lookat, b.lookat, weight), Lerp(a.vup, b.vup, weight),
+        Lerp(a.vfov, b.vfov, weight), Lerp(a.aperture, b.aperture, weight), Lerp(a.focus_dist, b.focus_dist, weight) };
+}
+
+Transform Animation::GetTransform(const ObjectTrack& track, int frame, const Point3& pivot)
+{
+    float weight;
+    const size_t k = FindSegment(track.keys, frame, weight);
+    const ObjectKey& a = track.keys[k];
+    const ObjectKey& b = weight == 0.0f ? a : track.keys[k + 1];
+
+    const Vector3 offset = Lerp(a.offset, b.offset, weight);
+    const Vector3 axis = Lerp(a.axis, b.axis, weight);
+    const float degrees = Lerp(a.degrees, b.degrees, weight);
+
+    Transform turn;
+    if (degrees != 0.0f && axis.GetSquaredLength() > 0.0f)
+    {
+        turn = Transform::Rotation(axis.GetNormalized(), degrees);
+    }
+    return Transform::Translation(pivot + offset) * turn * Transform::Translation(-pivot);
+}
+
+bool LoadAnimation(const char* path, Animation& animation, std::string& error)
+{
+    std::ifstream input(path);
+    if (!input)
+    {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+
+    std::string line;
+    for (int line_number = 1; std::getline(input, line); ++line_number)
+    {
+        char* cursor = line.data();
+        const char* keyword = NextToken(cursor);
+        if (!keyword)
+        {
+            continue;
+        }
+
+        bool ok = false;
+        if (std::strcmp(keyword, "frames") == 0)
+        {
+            ok = ReadInt(cursor, animation.frame_count, 1);
+        }
+        else if (std::strcmp(keyword, "camera") == 0)
+        {
+            Animation::CameraKey key;
+            float values[12];
+            if (ReadInt(cursor, key.frame, 0) && ReadFloats(cursor, values, 12))
+            {
+                key.camera = { Vector3(values[0], values[1], values[2]), Vector3(values[3], values[4], values[5]),
+                    Vector3(values[6], values[7], values[8]), values[9], values[10], values[11] };
+                InsertKey(animation.camera_keys, key);
+                ok = true;
+            }
+        }
+        else if (std::strcmp(keyword, "object") == 0)
+        {
+            int object;
+            Animation::ObjectKey key;
+            float values[7];
+            if (ReadInt(cursor, object) && ReadInt(cursor, key.frame, 0) && ReadFloats(cursor, values, 7))
+            {
+                key.offset = Vector3(values[0], values[1], values[2]);
+                key.axis = Vector3(values[3], values[4], values[5]);
+                key.degrees = values[6];
+
+                auto track = std::find_if(animation.tracks.begin(), animation.tracks.end(), [object](const Animation::ObjectTrack& t) { return t.index == object; });
+                if (track == animation.tracks.end())
+                {
+                    animation.tracks.push_back({ object, {} });
+                    track = animation.tracks.end() - 1;
+                }
+                InsertKey(track->keys, key);
+                ok = true;
+            }
+        }
+
+        if (!ok || NextToken(cursor))
+        {
+            error = std::string(path) + ":" + std::to_string(line_number) + ": malformed statement";
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../Scene.h"
+#include "../Transform.h"
+
+#include <string>
+#include <vector>
+
+// Camera and object keyframes for a sequence of frames, read from a text file
+// with one statement per line, '#' starting a comment:
+//
+//   frames COUNT
+//   camera FRAME  lookfrom_x y z  lookat_x y z  vup_x y z  vfov aperture focus_dist
+//   object INDEX FRAME  offset_x y z  axis_x y z degrees
+//
+// Values are interpolated linearly between keyframes and held before the
+// first and after the last. Without camera keyframes the scene's camera is
+// used throughout.
+//
+// INDEX picks a top-level object of the scene, counting from the end when
+// negative: the built-in scenes add the ground first and their three large
+// spheres last. An object keyframe moves the object by offset and turns it
+// by degrees about axis through the center of its bounding box.
+struct Animation
+{
+    struct CameraKey
+    {
+        int frame;
+        CameraSetup camera;
+    };
+
+    struct ObjectKey
+    {
+        int frame;
+        Vector3 offset;
+        Vector3 axis;
+        float degrees;
+    };
+
+    struct ObjectTrack
+    {
+        int index;                   // As written; may be negative
+        std::vector<ObjectKey> keys; // Sorted by frame
+    };
+
+    int frame_count = 1;
+    std::vector<CameraKey> camera_keys;   // Sorted by frame
+    std::vector<ObjectTrack> tracks;
+
+    CameraSetup GetCamera(int frame, const CameraSetup& scene_camera) const;
+
+    // Placement of the track's object at frame, relative to where the scene put it
+    static Transform GetTransform(const ObjectTrack& track, int frame, const Point3& pivot);
+};
+
+// Returns false and sets error on failure
+bool LoadAnimation(const char* path, Animation& animation, std::string& error);
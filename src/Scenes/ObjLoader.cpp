@@ -0,0 +1,154 @@
+#include "ObjLoader.h"
+#include "../Materials/Lambertian.h"
+#include "../Objects/Sphere.h"
+#include "TextParsing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace
+{
+    // Parses the vertex part of a face corner ("v", "v/vt", "v/vt/vn" or "v//vn")
+    // into a zero-based index. Negative indices count back from the last vertex.
+    bool ParseCorner(const char* token, size_t vertex_count, int64_t& index)
+    {
+        char* end;
+        const long long value = std::strtoll(token, &end, 10);
+        if (end == token || (*end != '\0' && *end != '/'))
+        {
+            return false;
+        }
+        if (value > 0)
+        {
+            index = value - 1;   // Checked against the final vertex count after loading
+            return true;
+        }
+        index = static_cast<int64_t>(vertex_count) + value;
+        return value < 0 && index >= 0;
+    }
+}
+
+std::shared_ptr<TriangleMesh> LoadObj(const char* path, MaterialId mat_id, std::string& error)
+{
+    std::ifstream input(path);
+    if (!input)
+    {
+        error = std::string("cannot open ") + path;
+        return nullptr;
+    }
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    int64_t max_index = -1;
+
+    std::string line;
+    for (int line_number = 1; std::getline(input, line); ++line_number)
+    {
+        char* cursor = line.data();
+        const char* keyword = NextToken(cursor);
+        if (!keyword)
+        {
+            continue;
+        }
+
+        bool ok = true;
+        if (std::strcmp(keyword, "v") == 0)
+        {
+            // An optional w or vertex color after x y z is ignored
+            float p[3];
+            ok = ReadFloats(cursor, p, 3) && std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]);
+            positions.insert(positions.end(), p, p + 3);
+        }
+        else if (std::strcmp(keyword, "f") == 0)
+        {
+            const size_t vertex_count = positions.size() / 3;
+            int64_t first = -1;
+            int64_t previous = -1;
+            int corners = 0;
+            while (const char* token = NextToken(cursor))
+            {
+                int64_t index;
+                if (!ParseCorner(token, vertex_count, index))
+                {
+                    ok = false;
+                    break;
+                }
+                max_index = std::max(max_index, index);
+                if (corners == 0)
+                {
+                    first = index;
+                }
+                else if (corners >= 2)
+                {
+                    indices.push_back(static_cast<uint32_t>(first));
+                    indices.push_back(static_cast<uint32_t>(previous));
+                    indices.push_back(static_cast<uint32_t>(index));
+                }
+                previous = index;
+                ++corners;
+            }
+            ok = ok && corners >= 3;
+        }
+
+        if (!ok)
+        {
+            error = std::string(path) + ":" + std::to_string(line_number) + ": malformed statement";
+            return nullptr;
+        }
+    }
+
+    const size_t vertex_count = positions.size() / 3;
+    if (vertex_count > std::numeric_limits<uint32_t>::max())
+    {
+        error = "too many vertices for 32-bit indices";
+        return nullptr;
+    }
+    if (max_index >= static_cast<int64_t>(vertex_count))
+    {
+        error = "face refers to a missing vertex";
+        return nullptr;
+    }
+    if (indices.empty())
+    {
+        error = "no faces";
+        return nullptr;
+    }
+
+    // Growing the arrays left up to half of them unused
+    positions.shrink_to_fit();
+    indices.shrink_to_fit();
+    return std::make_shared<TriangleMesh>(std::move(positions), std::move(indices), mat_id);
+}
+
+Scene* LoadObjScene(const char* path, std::string& error)
+{
+    Scene* scene = new Scene();
+    const std::shared_ptr<TriangleMesh> mesh = LoadObj(path, scene->materials.Add<Lambertian>(Vector3(0.7, 0.6, 0.5)), error);
+    if (!mesh)
+    {
+        delete scene;
+        return nullptr;
+    }
+
+    const AABB box = mesh->GetBoundingBox();
+    const Point3 center = box.GetCentroid();
+    const float radius = std::max(0.5f * (box.maximum - box.minimum).GetLength(), 1e-3f);
+
+    // A ground sphere large enough to look flat, touching the bottom of the mesh
+    const float ground_radius = 1000.0f * radius;
+    scene->objects.Add(std::make_shared<Sphere>(Vector3(center.x, box.minimum.y - ground_radius, center.z), ground_radius,
+        scene->materials.Add<Lambertian>(Vector3(0.5, 0.5, 0.5))));
+    scene->objects.Add(mesh);
+
+    // Far enough back for the bounding sphere to fit a 30 degree field of view
+    const float distance = 4.0f * radius;
+    const Vector3 lookfrom = center + distance * Vector3(0.55f, 0.35f, 0.76f).GetNormalized();
+    scene->camera = { lookfrom, center, Vector3(0, 1, 0), 30.0f, 0.0f, distance };
+
+    return scene;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../Objects/TriangleMesh.h"
+#include "../Scene.h"
+
+#include <memory>
+#include <string>
+
+// Reads the geometry of a Wavefront OBJ file into one mesh. Only v and f
+// statements are used: texture coordinates, normals, groups and materials
+// are skipped, and polygons are split into triangle fans. The file is read
+// line by line, so memory use is the size of the mesh itself. Returns nullptr
+// and sets error on failure.
+std::shared_ptr<TriangleMesh> LoadObj(const char* path, MaterialId mat_id, std::string& error);
+
+// A scene showing an OBJ file on a ground plane, with the camera framing the mesh
+Scene* LoadObjScene(const char* path, std::string& error);
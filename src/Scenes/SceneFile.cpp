@@ -0,0 +1,352 @@
+#include "SceneFile.h"
+#include "../MappedFile.h"
+#include "../Materials/Dielectric.h"
+#include "../Materials/Lambertian.h"
+#include "../Materials/Metal.h"
+#include "../Objects/SphereBVH.h"
+#include "TextParsing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+static_assert(sizeof(SceneFileHeader) == 136, "SceneFileHeader layout is part of the file format");
+static_assert(sizeof(PackedMaterial) == 20, "PackedMaterial layout is part of the file format");
+
+namespace
+{
+    constexpr uint64_t section_alignment = 64;
+
+    uint64_t Align(uint64_t offset)
+    {
+        return (offset + section_alignment - 1) & ~(section_alignment - 1);
+    }
+
+    // Writes sections in file order, padding the gaps between them with zeros
+    struct SectionWriter
+    {
+        std::FILE* file;
+        uint64_t position = 0;
+
+        bool Write(uint64_t offset, const void* data, size_t size)
+        {
+            static const char zeros[section_alignment] = {};
+            while (position < offset)
+            {
+                const size_t pad = static_cast<size_t>(std::min<uint64_t>(offset - position, section_alignment));
+                if (std::fwrite(zeros, 1, pad, file) != pad)
+                {
+                    return false;
+                }
+                position += pad;
+            }
+            position += size;
+            return std::fwrite(data, 1, size, file) == size;
+        }
+    };
+
+    bool InBounds(uint64_t offset, uint64_t size, uint64_t file_size)
+    {
+        return offset % alignof(float) == 0 && offset <= file_size && size <= file_size - offset;
+    }
+
+    // Checks that every interior node's children are in range and point forward,
+    // every leaf's spheres exist and the depth fits the traversal stack
+    bool ValidateNodes(const BVHNode* nodes, uint32_t node_count, uint32_t sphere_count)
+    {
+        struct Entry
+        {
+            uint32_t node;
+            int depth;
+        };
+        std::vector<Entry> pending = { { 0, 1 } };
+        uint32_t visited = 0;
+        while (!pending.empty())
+        {
+            const Entry entry = pending.back();
+            pending.pop_back();
+            if (entry.depth > BVHBuilder::stack_size || ++visited > node_count)
+            {
+                return false;
+            }
+
+            const BVHNode& node = nodes[entry.node];
+            if (node.count > 0)
+            {
+                if (node.offset > sphere_count || node.count > sphere_count - node.offset)
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (node.axis > 2 || entry.node + 1 >= node_count || node.offset <= entry.node + 1 || node.offset >= node_count)
+            {
+                return false;
+            }
+            pending.push_back({ node.offset, entry.depth + 1 });
+            pending.push_back({ entry.node + 1, entry.depth + 1 });
+        }
+        return true;
+    }
+}
+
+bool ConvertSceneText(const char* text_path, const char* scene_path, bool store_bvh, std::string& error)
+{
+    std::ifstream input(text_path);
+    if (!input)
+    {
+        error = std::string("cannot open ") + text_path;
+        return false;
+    }
+
+    SceneFileHeader header = {};
+    std::memcpy(header.magic, scene_file_magic, sizeof(header.magic));
+    header.version = scene_file_version;
+    header.header_size = sizeof(SceneFileHeader);
+    const float default_camera[12] = { 13, 2, 3, 0, 0, 0, 0, 1, 0, 20, 0.1f, 7 };
+    std::memcpy(header.camera, default_camera, sizeof(header.camera));
+
+    std::vector<PackedMaterial> materials;
+    std::unordered_map<std::string, MaterialId> material_ids;
+    std::vector<SphereBVHData::InputSphere> spheres;
+
+    std::string line;
+    for (int line_number = 1; std::getline(input, line); ++line_number)
+    {
+        char* cursor = line.data();
+        const char* keyword = NextToken(cursor);
+        if (!keyword)
+        {
+            continue;
+        }
+
+        bool ok = false;
+        if (std::strcmp(keyword, "camera") == 0)
+        {
+            ok = ReadFloats(cursor, header.camera, 12);
+        }
+        else if (std::strcmp(keyword, "material") == 0)
+        {
+            const char* name = NextToken(cursor);
+            const char* type = name ? NextToken(cursor) : nullptr;
+            PackedMaterial material = {};
+            if (type && std::strcmp(type, "lambertian") == 0)
+            {
+                material.type = static_cast<uint32_t>(MaterialType::Lambertian);
+                ok = ReadFloats(cursor, material.albedo, 3);
+            }
+            else if (type && std::strcmp(type, "metal") == 0)
+            {
+                material.type = static_cast<uint32_t>(MaterialType::Metal);
+                ok = ReadFloats(cursor, material.albedo, 3) && ReadFloats(cursor, &material.parameter, 1);
+            }
+            else if (type && std::strcmp(type, "dielectric") == 0)
+            {
+                material.type = static_cast<uint32_t>(MaterialType::Dielectric);
+                ok = ReadFloats(cursor, &material.parameter, 1);
+            }
+            if (ok)
+            {
+                ok = material_ids.emplace(name, static_cast<MaterialId>(materials.size())).second;
+                materials.push_back(material);
+            }
+        }
+        else if (std::strcmp(keyword, "sphere") == 0)
+        {
+            float values[4];
+            if (ReadFloats(cursor, values, 4))
+            {
+                const char* name = NextToken(cursor);
+                const auto it = name ? material_ids.find(name) : material_ids.end();
+                if (it != material_ids.end())
+                {
+                    spheres.push_back({ Point3(values[0], values[1], values[2]), values[3], it->second });
+                    ok = true;
+                }
+            }
+        }
+
+        if (!ok || NextToken(cursor))
+        {
+            error = std::string(text_path) + ":" + std::to_string(line_number) + ": malformed statement";
+            return false;
+        }
+    }
+
+    std::shared_ptr<SphereBVHData> data;
+    if (store_bvh)
+    {
+        data = SphereBVHData::Build(spheres);
+    }
+    else
+    {
+        // Same arrays in input order; the loader builds the tree
+        data = std::make_shared<SphereBVHData>();
+        data->count = static_cast<uint32_t>(spheres.size());
+        const size_t padded = spheres.size() + SphereSet::lane_padding;
+        data->center_x.assign(padded, 0.0f);
+        data->center_y.assign(padded, 0.0f);
+        data->center_z.assign(padded, 0.0f);
+        data->radius.assign(padded, 0.0f);
+        data->mat_ids.assign(padded, 0);
+        for (size_t i = 0; i < spheres.size(); ++i)
+        {
+            data->center_x[i] = spheres[i].center.x;
+            data->center_y[i] = spheres[i].center.y;
+            data->center_z[i] = spheres[i].center.z;
+            data->radius[i] = spheres[i].radius;
+            data->mat_ids[i] = spheres[i].mat_id;
+        }
+    }
+
+    header.material_count = static_cast<uint32_t>(materials.size());
+    header.sphere_count = data->count;
+    header.node_count = static_cast<uint32_t>(data->nodes.size());
+
+    const uint64_t array_bytes = (static_cast<uint64_t>(data->count) + SphereSet::lane_padding) * sizeof(float);
+    header.materials_offset = Align(sizeof(SceneFileHeader));
+    header.center_x_offset = Align(header.materials_offset + materials.size() * sizeof(PackedMaterial));
+    header.center_y_offset = Align(header.center_x_offset + array_bytes);
+    header.center_z_offset = Align(header.center_y_offset + array_bytes);
+    header.radius_offset = Align(header.center_z_offset + array_bytes);
+    header.mat_id_offset = Align(header.radius_offset + array_bytes);
+    header.nodes_offset = Align(header.mat_id_offset + array_bytes);
+
+    std::FILE* file = std::fopen(scene_path, "wb");
+    if (!file)
+    {
+        error = std::string("cannot create ") + scene_path;
+        return false;
+    }
+    SectionWriter writer = { file };
+    const bool written = writer.Write(0, &header, sizeof(header))
+        && writer.Write(header.materials_offset, materials.data(), materials.size() * sizeof(PackedMaterial))
+        && writer.Write(header.center_x_offset, data->center_x.data(), array_bytes)
+        && writer.Write(header.center_y_offset, data->center_y.data(), array_bytes)
+        && writer.Write(header.center_z_offset, data->center_z.data(), array_bytes)
+        && writer.Write(header.radius_offset, data->radius.data(), array_bytes)
+        && writer.Write(header.mat_id_offset, data->mat_ids.data(), array_bytes)
+        && writer.Write(header.nodes_offset, data->nodes.data(), data->nodes.size() * sizeof(BVHNode));
+    if (std::fclose(file) != 0 || !written)
+    {
+        error = std::string("cannot write ") + scene_path;
+        return false;
+    }
+    return true;
+}
+
+Scene* LoadSceneFile(const char* path, std::string& error)
+{
+    const std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+    if (!file)
+    {
+        error = std::string("cannot map ") + path;
+        return nullptr;
+    }
+
+    const uint8_t* base = file->GetData();
+    const uint64_t file_size = file->GetSize();
+    SceneFileHeader header;
+    if (file_size < sizeof(header))
+    {
+        error = "not a scene file";
+        return nullptr;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, scene_file_magic, sizeof(header.magic)) != 0)
+    {
+        error = "not a scene file";
+        return nullptr;
+    }
+    if (header.version != scene_file_version || header.header_size != sizeof(SceneFileHeader))
+    {
+        error = "unsupported scene file version " + std::to_string(header.version);
+        return nullptr;
+    }
+
+    const uint64_t array_bytes = (static_cast<uint64_t>(header.sphere_count) + SphereSet::lane_padding) * sizeof(float);
+    if (!InBounds(header.materials_offset, static_cast<uint64_t>(header.material_count) * sizeof(PackedMaterial), file_size)
+        || !InBounds(header.center_x_offset, array_bytes, file_size)
+        || !InBounds(header.center_y_offset, array_bytes, file_size)
+        || !InBounds(header.center_z_offset, array_bytes, file_size)
+        || !InBounds(header.radius_offset, array_bytes, file_size)
+        || !InBounds(header.mat_id_offset, array_bytes, file_size)
+        || !InBounds(header.nodes_offset, static_cast<uint64_t>(header.node_count) * sizeof(BVHNode), file_size)
+        || header.nodes_offset % alignof(BVHNode) != 0)
+    {
+        error = "truncated or corrupt scene file";
+        return nullptr;
+    }
+
+    Scene* scene = new Scene();
+    const float* c = header.camera;
+    scene->camera = { Vector3(c[0], c[1], c[2]), Vector3(c[3], c[4], c[5]), Vector3(c[6], c[7], c[8]), c[9], c[10], c[11] };
+
+    // Materials are few and are turned into objects; the spheres stay in the mapping
+    for (uint32_t i = 0; i < header.material_count; ++i)
+    {
+        PackedMaterial material;
+        std::memcpy(&material, base + header.materials_offset + i * sizeof(PackedMaterial), sizeof(material));
+        const Vector3 albedo(material.albedo[0], material.albedo[1], material.albedo[2]);
+        switch (static_cast<MaterialType>(material.type))
+        {
+        case MaterialType::Lambertian: scene->materials.Add<Lambertian>(albedo); break;
+        case MaterialType::Metal: scene->materials.Add<Metal>(albedo, material.parameter); break;
+        case MaterialType::Dielectric: scene->materials.Add<Dielectric>(material.parameter); break;
+        default:
+            error = "unknown material type " + std::to_string(material.type);
+            delete scene;
+            return nullptr;
+        }
+    }
+
+    SphereBVHView view = {
+        reinterpret_cast<const BVHNode*>(base + header.nodes_offset),
+        header.node_count,
+        {
+            reinterpret_cast<const float*>(base + header.center_x_offset),
+            reinterpret_cast<const float*>(base + header.center_y_offset),
+            reinterpret_cast<const float*>(base + header.center_z_offset),
+            reinterpret_cast<const float*>(base + header.radius_offset) },
+        reinterpret_cast<const MaterialId*>(base + header.mat_id_offset),
+        header.sphere_count };
+
+    // A corrupt file must not send the trace loop out of bounds, so the index
+    // data is checked once here; the float arrays need no checking
+    for (uint32_t i = 0; i < header.sphere_count; ++i)
+    {
+        if (view.mat_ids[i] >= header.material_count)
+        {
+            error = "sphere refers to a missing material";
+            delete scene;
+            return nullptr;
+        }
+    }
+    if (header.node_count > 0 && !ValidateNodes(view.nodes, header.node_count, header.sphere_count))
+    {
+        error = "corrupt BVH in scene file";
+        delete scene;
+        return nullptr;
+    }
+
+    if (header.node_count == 0 && header.sphere_count > 0)
+    {
+        std::vector<SphereBVHData::InputSphere> spheres(header.sphere_count);
+        for (uint32_t i = 0; i < header.sphere_count; ++i)
+        {
+            spheres[i] = { Point3(view.spheres.center_x[i], view.spheres.center_y[i], view.spheres.center_z[i]), view.spheres.radius[i], view.mat_ids[i] };
+        }
+        const std::shared_ptr<SphereBVHData> data = SphereBVHData::Build(spheres);
+        scene->objects.Add(std::make_shared<SphereBVH>(data->GetView(), data));
+    }
+    else if (header.sphere_count > 0)
+    {
+        scene->objects.Add(std::make_shared<SphereBVH>(view, file));
+    }
+
+    return scene;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../Scene.h"
+
+#include <cstdint>
+#include <string>
+
+// Binary scene files (.rtscene). Everything after the header is stored in the
+// in-memory layout, little-endian, with every array 64-byte aligned, so a
+// loaded scene traces straight from the mapped pages:
+//
+//   SceneFileHeader
+//   PackedMaterial[material_count]
+//   float center_x[], center_y[], center_z[], radius[]   sphere_count + 16 entries each
+//   MaterialId mat_ids[]                                  sphere_count + 16 entries
+//   BVHNode nodes[node_count]                             optional
+//
+// Spheres are stored in the leaf order of the BVH. Without a stored BVH
+// (node_count 0) the loader builds one, which copies the spheres.
+
+constexpr char scene_file_magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+constexpr uint32_t scene_file_version = 1;
+
+struct SceneFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;        // sizeof(SceneFileHeader) of the writer
+    uint32_t material_count;
+    uint32_t sphere_count;
+    uint32_t node_count;
+    uint32_t reserved;
+    float camera[12];            // lookfrom, lookat, vup, vfov, aperture, focus_dist
+    uint64_t materials_offset;
+    uint64_t center_x_offset;
+    uint64_t center_y_offset;
+    uint64_t center_z_offset;
+    uint64_t radius_offset;
+    uint64_t mat_id_offset;
+    uint64_t nodes_offset;
+};
+
+struct PackedMaterial
+{
+    uint32_t type;               // MaterialType; Custom is not allowed
+    float albedo[3];             // Unused by dielectrics
+    float parameter;             // Fuzz for metals, index of refraction for dielectrics
+};
+
+// Converts a text description to a binary scene file. The text has one
+// statement per line, '#' starts a comment:
+//
+//   camera  lookfrom_x y z  lookat_x y z  vup_x y z  vfov aperture focus_dist
+//   material NAME lambertian r g b
+//   material NAME metal r g b fuzz
+//   material NAME dielectric index_of_refraction
+//   sphere x y z radius MATERIAL_NAME
+//
+// The text is read line by line, never held in memory as a whole. Returns
+// false and sets error on failure.
+bool ConvertSceneText(const char* text_path, const char* scene_path, bool store_bvh, std::string& error);
+
+// Maps a binary scene file and returns a scene whose geometry reads from the
+// mapping, or nullptr with error set. Only the materials are copied.
+Scene* LoadSceneFile(const char* path, std::string& error);
@@ -0,0 +1,170 @@
+#include "SphereField.h"
+#include "../Materials/Dielectric.h"
+#include "../Materials/Lambertian.h"
+#include "../Materials/Metal.h"
+#include "../Objects/Instance.h"
+#include "../Objects/Sphere.h"
+#include "../Objects/SphereBVH.h"
+#include "../Objects/SphereSet.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // Small spheres on a (2 * half_extent)^2 grid, jittered within their cell.
+    // A sphere is diffuse below diffuse_limit, metal below metal_limit and
+    // glass otherwise.
+    Scene* Sphere_field(uint64_t seed, int half_extent, float diffuse_limit, float metal_limit)
+    {
+        SeedRandom(seed, 0);
+
+        Scene* scene = new Scene();
+        scene->camera = { Vector3(13, 2, 3), Vector3(0, 0, 0), Vector3(0, 1, 0), 20.0f, 0.1f, 7.0f };
+        MaterialTable& materials = scene->materials;
+        HittableList* world = &scene->objects;
+
+        world->Add(std::make_shared<Sphere>(Vector3(0, -1000, 0), 1000, materials.Add<Lambertian>(Vector3(0.5, 0.5, 0.5))));
+
+        // Small spheres are packed into one SphereSet per 4x4 block of the grid,
+        // which keeps each set spatially compact for the BVH above it
+        const int block_size = 4;
+        const int grid_size = 2 * half_extent;
+        const int blocks_per_side = (grid_size + block_size - 1) / block_size;
+        std::vector<std::shared_ptr<SphereSet>> blocks(blocks_per_side * blocks_per_side);
+        for (auto& block : blocks)
+        {
+            block = std::make_shared<SphereSet>();
+        }
+
+        for (int a = -half_extent; a < half_extent; ++a)
+        {
+            for (int b = -half_extent; b < half_extent; ++b)
+            {
+                SphereSet& block = *blocks[((a + half_extent) / block_size) * blocks_per_side + (b + half_extent) / block_size];
+
+                const auto choose_mat = random_float();
+                Vector3 center(a + 0.9 * random_float(), 0.2, b + 0.9 * random_float());
+                if ((center - Vector3(4, 0.2, 0)).GetLength() > 0.9)
+                {
+                    if (choose_mat < diffuse_limit)
+                    {
+                        auto albedo = Vector3::Random() * Vector3::Random();
+                        block.Add(center, 0.2, materials.Add<Lambertian>(albedo));
+                    }
+                    else if (choose_mat < metal_limit)
+                    {
+                        auto albedo = Vector3::Random(0.5, 1);
+                        auto fuzz = random_float(0, 0.5);
+                        block.Add(center, 0.2, materials.Add<Metal>(albedo, fuzz));
+                    }
+                    else
+                    {
+                        block.Add(center, 0.2, materials.Add<Dielectric>(1.5));
+                    }
+                }
+            }
+        }
+
+        for (auto& block : blocks)
+        {
+            if (block->GetSize() > 0)
+            {
+                world->Add(std::move(block));
+            }
+        }
+
+        world->Add(std::make_shared<Sphere>(Vector3(0, 1, 0), 1.0, materials.Add<Dielectric>(1.5)));
+
+        world->Add(std::make_shared<Sphere>(Vector3(-4, 1, -2), 1.0, materials.Add<Lambertian>(Vector3(0.4, 0.2, 0.1))));
+
+        world->Add(std::make_shared<Sphere>(Vector3(4, 1, 0), 1.0, materials.Add<Metal>(Vector3(0.7, 0.6, 0.5), 0.0)));
+
+        return scene;
+    }
+}
+
+Scene* random_scene(uint64_t seed)
+{
+    return Sphere_field(seed, 11, 0.8f, 0.95f);
+}
+
+Scene* dense_scene(uint64_t seed)
+{
+    return Sphere_field(seed, 50, 0.8f, 0.95f);
+}
+
+Scene* glass_scene(uint64_t seed)
+{
+    return Sphere_field(seed, 11, 0.2f, 0.3f);
+}
+
+Scene* instanced_scene(uint64_t seed)
+{
+    SeedRandom(seed, 0);
+
+    Scene* scene = new Scene();
+    scene->camera = { Vector3(13, 2, 3), Vector3(0, 0, 0), Vector3(0, 1, 0), 20.0f, 0.1f, 7.0f };
+    MaterialTable& materials = scene->materials;
+
+    scene->objects.Add(std::make_shared<Sphere>(Vector3(0, -1000, 0), 1000, materials.Add<Lambertian>(Vector3(0.5, 0.5, 0.5))));
+
+    // One cluster of small spheres in a unit cell, shared by every instance
+    const int cluster_size = 64;
+    std::vector<SphereBVHData::InputSphere> cluster;
+    for (int i = 0; i < cluster_size; ++i)
+    {
+        const float radius = random_float(0.04f, 0.1f);
+        const Point3 center(random_float(-0.35f, 0.35f), radius + random_float(0.0f, 0.6f), random_float(-0.35f, 0.35f));
+        cluster.push_back({ center, radius, 0 });
+    }
+    const std::shared_ptr<SphereBVHData> data = SphereBVHData::Build(cluster);
+    const std::shared_ptr<const Hittable> geometry = std::make_shared<SphereBVH>(data->GetView(), data);
+
+    // Instances pick from a small palette instead of owning a material each
+    const int palette_size = 16;
+    MaterialId palette[palette_size];
+    for (int i = 0; i < palette_size; ++i)
+    {
+        const float choose_mat = random_float();
+        if (choose_mat < 0.7f)
+        {
+            palette[i] = materials.Add<Lambertian>(Vector3::Random() * Vector3::Random());
+        }
+        else if (choose_mat < 0.9f)
+        {
+            palette[i] = materials.Add<Metal>(Vector3::Random(0.5, 1), random_float(0, 0.5));
+        }
+        else
+        {
+            palette[i] = materials.Add<Dielectric>(1.5);
+        }
+    }
+
+    const int half_extent = 200;
+    const Vector3 up(0, 1, 0);
+    for (int a = -half_extent; a < half_extent; ++a)
+    {
+        for (int b = -half_extent; b < half_extent; ++b)
+        {
+            const Vector3 position(a + 0.5f, 0.0f, b + 0.5f);
+            const Transform placement = Transform::Translation(position)
+                * Transform::Rotation(up, random_float(0.0f, 360.0f))
+                * Transform::Scale(random_float(0.6f, 1.0f));
+            const MaterialId material = palette[static_cast<int>(random_float() * palette_size) % palette_size];
+            scene->objects.Add(std::make_shared<Instance>(geometry, placement, material));
+        }
+    }
+
+    return scene;
+}
+
+Scene* Make_scene(const char* name, uint64_t seed)
+{
+    if (std::strcmp(name, "random") == 0) return random_scene(seed);
+    if (std::strcmp(name, "dense") == 0) return dense_scene(seed);
+    if (std::strcmp(name, "glass") == 0) return glass_scene(seed);
+    if (std::strcmp(name, "instanced") == 0) return instanced_scene(seed);
+    return nullptr;
+}
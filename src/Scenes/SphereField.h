@@ -0,0 +1,21 @@
+#pragma once
+
+#include "../Scene.h"
+
+#include <cstdint>
+
+// The cover scene: a 22x22 grid of small spheres around three large ones
+Scene* random_scene(uint64_t seed);
+
+// The same layout on a 100x100 grid, for BVH and SphereSet heavy workloads
+Scene* dense_scene(uint64_t seed);
+
+// The cover layout with mostly glass spheres, which keeps paths long
+Scene* glass_scene(uint64_t seed);
+
+// 160000 instances of one shared 64-sphere cluster, each placed, turned, scaled
+// and given a material of its own
+Scene* instanced_scene(uint64_t seed);
+
+// Looks a scene up by name ("random", "dense", "glass" or "instanced"); returns nullptr for unknown names
+Scene* Make_scene(const char* name, uint64_t seed);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <climits>
+#include <cstdlib>
+
+// Helpers for the line-based text formats (scene descriptions, OBJ)
+
+// Splits the line in place at whitespace; returns nullptr at the end or at a comment
+inline char* NextToken(char*& cursor)
+{
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+    {
+        ++cursor;
+    }
+    if (*cursor == '\0' || *cursor == '#')
+    {
+        return nullptr;
+    }
+    char* token = cursor;
+    while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r')
+    {
+        ++cursor;
+    }
+    if (*cursor != '\0')
+    {
+        *cursor++ = '\0';
+    }
+    return token;
+}
+
+inline bool ReadFloats(char*& cursor, float* out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const char* token = NextToken(cursor);
+        if (!token)
+        {
+            return false;
+        }
+        char* end;
+        out[i] = std::strtof(token, &end);
+        if (*end != '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads a whole number no smaller than min_value. Parsed as 64 bits, so a
+// value past the range of int is refused rather than wrapped or rounded.
+inline bool ReadInt(char*& cursor, int& out, int min_value = INT_MIN)
+{
+    const char* token = NextToken(cursor);
+    if (!token)
+    {
+        return false;
+    }
+    char* end;
+    const long long value = std::strtoll(token, &end, 10);
+    if (*end != '\0' || value < min_value || value > INT_MAX)
+    {
+        return false;
+    }
+    out = static_cast<int>(value);
+    return true;
+}
@@ -0,0 +1,239 @@
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#if defined(_WIN32)
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace
+{
+    // Every CPU of the machine in node 0: the fallback where nothing better is known
+    CpuTopology GetFlatTopology()
+    {
+        CpuTopology topology;
+        const uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t cpu = 0; cpu < count; ++cpu)
+        {
+            topology.cpus.push_back(cpu);
+            topology.nodes.push_back(0);
+        }
+        return topology;
+    }
+
+    // One past the highest CPU number an affinity mask can name
+    unsigned long GetCpuLimit()
+    {
+#if defined(_WIN32)
+        return 64ul * GetMaximumProcessorGroupCount();
+#elif defined(__linux__)
+        return CPU_SETSIZE;
+#else
+        return std::max(1u, std::thread::hardware_concurrency());
+#endif
+    }
+}
+
+bool ParseCpuList(const char* text, std::vector<uint32_t>& cpus)
+{
+    cpus.clear();
+    const unsigned long limit = GetCpuLimit();
+    const char* cursor = text;
+    while (*cursor)
+    {
+        char* end;
+        const unsigned long first = std::strtoul(cursor, &end, 10);
+        if (end == cursor)
+        {
+            return false;
+        }
+        unsigned long last = first;
+        cursor = end;
+        if (*cursor == '-')
+        {
+            last = std::strtoul(++cursor, &end, 10);
+            if (end == cursor || last < first)
+            {
+                return false;
+            }
+            cursor = end;
+        }
+        // Checked before the range is expanded, so a huge one cannot exhaust memory
+        if (last >= limit)
+        {
+            return false;
+        }
+        for (unsigned long cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(static_cast<uint32_t>(cpu));
+        }
+        if (*cursor == ',')
+        {
+            ++cursor;
+        }
+        else if (*cursor && *cursor != '\n')
+        {
+            return false;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return !cpus.empty();
+}
+
+#if defined(_WIN32)
+
+CpuTopology GetCpuTopology()
+{
+    CpuTopology topology;
+    const WORD group_count = GetActiveProcessorGroupCount();
+    for (WORD group = 0; group < group_count; ++group)
+    {
+        const DWORD count = GetActiveProcessorCount(group);
+        for (DWORD number = 0; number < count; ++number)
+        {
+            PROCESSOR_NUMBER processor = {};
+            processor.Group = group;
+            processor.Number = static_cast<BYTE>(number);
+            USHORT node = 0;
+            if (!GetNumaProcessorNodeEx(&processor, &node) || node == 0xffff)
+            {
+                node = 0;
+            }
+            topology.cpus.push_back(group * 64u + number);
+            topology.nodes.push_back(node);
+        }
+    }
+    if (topology.cpus.empty())
+    {
+        return GetFlatTopology();
+    }
+    topology.node_count = *std::max_element(topology.nodes.begin(), topology.nodes.end()) + 1;
+    return topology;
+}
+
+bool PinThread(std::thread& thread, uint32_t cpu)
+{
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = static_cast<WORD>(cpu / 64);
+    affinity.Mask = static_cast<KAFFINITY>(1) << (cpu % 64);
+    return SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr) != 0;
+}
+
+#elif defined(__linux__)
+
+CpuTopology GetCpuTopology()
+{
+    cpu_set_t usable;
+    CPU_ZERO(&usable);
+    if (sched_getaffinity(0, sizeof(usable), &usable) != 0)
+    {
+        return GetFlatTopology();
+    }
+
+    // Node directories are numbered densely in practice, but a gap ends the
+    // scan; CPUs no node lists stay in node 0
+    std::vector<uint32_t> node_of_cpu(CPU_SETSIZE, 0);
+    uint32_t node_count = 1;
+    for (uint32_t node = 0;; ++node)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        std::vector<uint32_t> node_cpus;
+        if (!file || !std::getline(file, list) || !ParseCpuList(list.c_str(), node_cpus))
+        {
+            break;
+        }
+        for (const uint32_t cpu : node_cpus)
+        {
+            if (cpu < node_of_cpu.size())
+            {
+                node_of_cpu[cpu] = node;
+            }
+        }
+        node_count = node + 1;
+    }
+
+    CpuTopology topology;
+    topology.node_count = node_count;
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &usable))
+        {
+            topology.cpus.push_back(cpu);
+            topology.nodes.push_back(node_of_cpu[cpu]);
+        }
+    }
+    return topology.cpus.empty() ? GetFlatTopology() : topology;
+}
+
+bool PinThread(std::thread& thread, uint32_t cpu)
+{
+    if (cpu >= CPU_SETSIZE)
+    {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+}
+
+#else
+
+CpuTopology GetCpuTopology()
+{
+    return GetFlatTopology();
+}
+
+bool PinThread(std::thread&, uint32_t)
+{
+    return false;
+}
+
+#endif
+
+bool PlaceWorkers(const CpuTopology& topology, const std::vector<uint32_t>& allowed, uint32_t count, std::vector<uint32_t>& cpus, std::string& error)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> candidates;   // (node, cpu)
+    for (size_t k = 0; k < topology.cpus.size(); ++k)
+    {
+        if (allowed.empty() || std::binary_search(allowed.begin(), allowed.end(), topology.cpus[k]))
+        {
+            candidates.push_back({ topology.nodes[k], topology.cpus[k] });
+        }
+    }
+    for (const uint32_t cpu : allowed)
+    {
+        if (!std::binary_search(topology.cpus.begin(), topology.cpus.end(), cpu))
+        {
+            error = "CPU " + std::to_string(cpu) + " is not available to this process";
+            return false;
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    cpus.clear();
+    const size_t worker_count = count > 0 ? count : candidates.size();
+    for (size_t w = 0; w < worker_count; ++w)
+    {
+        cpus.push_back(candidates[w % candidates.size()].second);
+    }
+    return true;
+}
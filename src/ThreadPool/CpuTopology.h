@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Logical CPUs this process may run on and the NUMA node of each. CPU ids
+// are the operating system's: on Windows, group * 64 + number in group.
+struct CpuTopology
+{
+    std::vector<uint32_t> cpus;    // Ascending
+    std::vector<uint32_t> nodes;   // Node of each entry of cpus
+    uint32_t node_count = 1;
+};
+
+CpuTopology GetCpuTopology();
+
+// Parses a list such as "0-7,16,18-19"; returns false if it is malformed or
+// names a CPU beyond what an affinity mask can hold
+bool ParseCpuList(const char* text, std::vector<uint32_t>& cpus);
+
+// One CPU per worker: count of them (all allowed CPUs if 0) taken from
+// allowed, or from every CPU of the process if allowed is empty. CPUs are
+// ordered node by node, so neighboring workers share a node and a pool of
+// fewer workers than a node has CPUs stays on one socket. More workers than
+// CPUs wrap around. Returns false and sets error if an allowed CPU is not
+// available to the process.
+bool PlaceWorkers(const CpuTopology& topology, const std::vector<uint32_t>& allowed, uint32_t count, std::vector<uint32_t>& cpus, std::string& error);
+
+// Restricts the thread to one CPU; false where the platform refuses or
+// affinity is not supported
+bool PinThread(std::thread& thread, uint32_t cpu);
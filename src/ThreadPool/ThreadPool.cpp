@@ -1,26 +1,92 @@
 #include "ThreadPool.h"
+#include "CpuTopology.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
 #include <thread>
 
-void ThreadPool::Start()
+namespace
 {
-    const uint32_t num_threads = std::thread::hardware_concurrency(); // Max # of threads the system supports
+    thread_local uint32_t current_worker = 0;
+}
+
+void ThreadPool::Start(uint32_t num_threads, const std::vector<uint32_t>& cpus)
+{
+    if (num_threads == 0) {
+        num_threads = !cpus.empty() ? static_cast<uint32_t>(cpus.size())
+            : std::max(1u, std::thread::hardware_concurrency()); // Max # of threads the system supports
+    }
+    should_terminate = false;
+    queues = std::make_unique<WorkerQueue[]>(num_threads);
     threads.resize(num_threads);
+    uint32_t unpinned = 0;
     for (uint32_t i = 0; i < num_threads; i++) {
-        threads.at(i) = std::thread(&ThreadPool::ThreadLoop, this);
+        threads.at(i) = std::thread(&ThreadPool::ThreadLoop, this, i);
+        // A refused pin leaves the worker free to migrate, which is only slower
+        if (!cpus.empty() && !PinThread(threads.at(i), cpus[i % cpus.size()])) {
+            unpinned++;
+        }
+    }
+    if (unpinned > 0) {
+        std::cerr << "Could not pin " << unpinned << " of " << num_threads << " worker threads; they may migrate between CPUs" << std::endl;
     }
 }
 
-void ThreadPool::QueueJob(const std::function<void()>& job)
+void ThreadPool::QueueJob(std::function<void()> job)
 {
+    QueueJob(std::move(job), next_queue.fetch_add(1, std::memory_order_relaxed));
+}
+
+void ThreadPool::QueueJob(std::function<void()> job, uint32_t worker)
+{
+    PushJob(std::move(job), worker);
     {
+        // Pairs with the predicate check in ThreadLoop so the wakeup cannot be lost
         std::unique_lock<std::mutex> lock(queue_mutex);
-        jobs.push(job);
     }
     mutex_condition.notify_one();
 }
 
+std::shared_ptr<JobBatch> ThreadPool::QueueBatch(int count, std::function<void(int)> job, const std::function<uint32_t(int)>& place)
+{
+    std::shared_ptr<JobBatch> batch(new JobBatch(count, std::move(job)));
+    const uint32_t first_queue = next_queue.fetch_add(static_cast<uint32_t>(count), std::memory_order_relaxed);
+    for (int k = 0; k < count; ++k) {
+        PushJob([batch, k] { batch->Run(k); }, place ? place(k) : first_queue + k);
+    }
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+    }
+    // One wakeup for the whole batch rather than one per job
+    mutex_condition.notify_all();
+    return batch;
+}
+
+void ThreadPool::PushJob(std::function<void()>&& job, uint32_t worker)
+{
+    assert(!threads.empty() && "jobs queued on a pool that is not started");
+
+    // Counted as active before it is visible, so WaitIdle cannot miss it
+    active_jobs.fetch_add(1, std::memory_order_relaxed);
+    WorkerQueue& queue = queues[worker % threads.size()];
+    {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    queued_jobs.fetch_add(1, std::memory_order_release);
+}
+
+void ThreadPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    idle_condition.wait(lock, [this] {
+        return active_jobs.load(std::memory_order_acquire) == 0;
+        });
+}
+
 void ThreadPool::Stop()
 {
+    WaitIdle();
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
         should_terminate = true;
@@ -30,28 +96,102 @@ void ThreadPool::Stop()
         active_thread.join();
     }
     threads.clear();
+    queues.reset();
 }
 
 int ThreadPool::GetJobsCount()
 {
-    return jobs.size();
+    return active_jobs.load(std::memory_order_acquire);
+}
+
+uint32_t ThreadPool::GetThreadCount() const
+{
+    return static_cast<uint32_t>(threads.size());
 }
 
-void ThreadPool::ThreadLoop()
+uint32_t ThreadPool::GetCurrentWorker()
 {
+    return current_worker;
+}
+
+bool ThreadPool::PopJob(uint32_t index, std::function<void()>& job)
+{
+    {
+        WorkerQueue& own = queues[index];
+        std::unique_lock<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.front());
+            own.jobs.pop_front();
+            return true;
+        }
+    }
+
+    const uint32_t num_threads = static_cast<uint32_t>(threads.size());
+    for (uint32_t offset = 1; offset < num_threads; offset++) {
+        WorkerQueue& victim = queues[(index + offset) % num_threads];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (lock.owns_lock() && !victim.jobs.empty()) {
+            job = std::move(victim.jobs.back());
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::ThreadLoop(uint32_t index)
+{
+    current_worker = index;
     while (true) {
         std::function<void()> job;
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            mutex_condition.wait(lock, [this] {
-                return !jobs.empty() || should_terminate;
-                });
-            if (should_terminate) {
-                return;
+        if (PopJob(index, job)) {
+            queued_jobs.fetch_sub(1, std::memory_order_relaxed);
+            job();
+            if (active_jobs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                // Under the lock, so a waiter between its check and its sleep still gets this
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                idle_condition.notify_all();
             }
-            job = jobs.front();
-            jobs.pop();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        mutex_condition.wait(lock, [this] {
+            return queued_jobs.load(std::memory_order_acquire) > 0 || should_terminate;
+            });
+        if (should_terminate) {
+            return;
+        }
+    }
+}
+
+void JobBatch::Wait(const std::function<void(int)>& on_progress, std::chrono::milliseconds interval)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (pending > 0) {
+        if (on_progress) {
+            // Reported unlocked, so a slow callback never holds up finishing jobs
+            const int unfinished = pending;
+            lock.unlock();
+            on_progress(unfinished);
+            lock.lock();
         }
-        job();
+        finished.wait_for(lock, interval, [this] { return pending == 0; });
+    }
+}
+
+int JobBatch::GetPendingCount()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return pending;
+}
+
+void JobBatch::Run(int k)
+{
+    job(k);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (--pending == 0) {
+        finished.notify_all();
     }
 }
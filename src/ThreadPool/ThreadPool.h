@@ -1,7 +1,13 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <thread>
+#include <vector>
 
 struct IntPair
 {
@@ -9,20 +15,79 @@ struct IntPair
     int b;
 };
 
+// Completion of the jobs queued by one ThreadPool::QueueBatch call
+class JobBatch {
+public:
+    // Blocks until every job of the batch has finished, and is woken by the
+    // last one. on_progress, if set, gets the number of unfinished jobs before
+    // waiting and again whenever interval passes without the batch finishing;
+    // it is called without the batch's lock held. Must not be called from a
+    // job of the same pool: the waiting worker takes no more jobs, so once
+    // every worker waits, the batch can never finish.
+    void Wait(const std::function<void(int)>& on_progress = nullptr, std::chrono::milliseconds interval = std::chrono::milliseconds(200));
+
+    int GetPendingCount();
+
+private:
+    friend class ThreadPool;
+
+    JobBatch(int count, std::function<void(int)>&& _job)
+        : pending(count), job(std::move(_job)) {}
+
+    void Run(int k);
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    int pending;                       // Jobs not yet finished, guarded by mutex
+    std::function<void(int)> job;      // Shared by every job of the batch
+};
+
 class ThreadPool {
 public:
-    void Start();
-    void QueueJob(const std::function<void()>& job);
+    // 0 spawns one thread per entry of cpus, or per hardware thread if cpus is
+    // empty. Worker i is pinned to cpus[i % cpus.size()] when cpus are given.
+    void Start(uint32_t num_threads = 0, const std::vector<uint32_t>& cpus = {});
+    // Jobs may only be queued between Start and Stop
+    void QueueJob(std::function<void()> job);
+    // Queues the job on one worker's own queue; others still steal it when idle
+    void QueueJob(std::function<void()> job, uint32_t worker);
+
+    // Runs job(k) for every k in [0, count) as jobs of their own and returns
+    // the handle to wait on. The function is stored once, not per job. place,
+    // if set, names the worker whose queue job k goes to.
+    std::shared_ptr<JobBatch> QueueBatch(int count, std::function<void(int)> job, const std::function<uint32_t(int)>& place = nullptr);
+
+    // Blocks until no job is queued or running. Must not be called from a job.
+    void WaitIdle();
+    // Finishes every queued job, then joins the workers
     void Stop();
 
+    // Jobs queued or still running
     int GetJobsCount();
+    uint32_t GetThreadCount() const;
+
+    // Index of the calling worker thread within its pool
+    static uint32_t GetCurrentWorker();
 
 private:
-    void ThreadLoop();
+    // Each worker owns a deque: it pops from the front, idle workers steal from the back
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    void PushJob(std::function<void()>&& job, uint32_t worker);
+    void ThreadLoop(uint32_t index);
+    bool PopJob(uint32_t index, std::function<void()>& job);
 
     bool should_terminate = false;           // Tells threads to stop looking for jobs
-    std::mutex queue_mutex;                  // Prevents data races to the job queue
-    std::condition_variable mutex_condition; // Allows threads to wait on new jobs or termination 
+    std::mutex queue_mutex;                  // Guards sleeping and termination, not the job queues
+    std::condition_variable mutex_condition; // Allows threads to wait on new jobs or termination
+    std::condition_variable idle_condition;  // Signaled when the last active job finishes
     std::vector<std::thread> threads;
-    std::queue<std::function<void()>> jobs;
-};
\ No newline at end of file
+    std::unique_ptr<WorkerQueue[]> queues;
+    std::atomic<uint32_t> next_queue = 0;    // Round-robin target for QueueJob
+    std::atomic<int> queued_jobs = 0;        // In the queues, for waking workers
+    std::atomic<int> active_jobs = 0;        // Queued or running, for WaitIdle
+};
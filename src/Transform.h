@@ -0,0 +1,118 @@
+#pragma once
+#include "Vector3Float.h"
+
+#include <cmath>
+
+// Affine transform stored as a 3x4 matrix: a linear part and a translation
+class Transform
+{
+public:
+    Transform()
+        : m{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } }
+    {
+    }
+
+    static Transform Translation(const Vector3& offset)
+    {
+        Transform t;
+        t.m[0][3] = offset.x;
+        t.m[1][3] = offset.y;
+        t.m[2][3] = offset.z;
+        return t;
+    }
+
+    static Transform Scale(float factor)
+    {
+        Transform t;
+        t.m[0][0] = t.m[1][1] = t.m[2][2] = factor;
+        return t;
+    }
+
+    // Counter-clockwise rotation about a unit axis
+    static Transform Rotation(const Vector3& axis, float degrees)
+    {
+        const float radians = degrees_to_radians(degrees);
+        const float c = std::cos(radians);
+        const float s = std::sin(radians);
+        const float k = 1.0f - c;
+
+        Transform t;
+        t.m[0][0] = c + axis.x * axis.x * k;
+        t.m[0][1] = axis.x * axis.y * k - axis.z * s;
+        t.m[0][2] = axis.x * axis.z * k + axis.y * s;
+        t.m[1][0] = axis.y * axis.x * k + axis.z * s;
+        t.m[1][1] = c + axis.y * axis.y * k;
+        t.m[1][2] = axis.y * axis.z * k - axis.x * s;
+        t.m[2][0] = axis.z * axis.x * k - axis.y * s;
+        t.m[2][1] = axis.z * axis.y * k + axis.x * s;
+        t.m[2][2] = c + axis.z * axis.z * k;
+        return t;
+    }
+
+    // Applies b first, then this transform
+    Transform operator*(const Transform& b) const
+    {
+        Transform t;
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                t.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j] + (j == 3 ? m[i][3] : 0.0f);
+            }
+        }
+        return t;
+    }
+
+    // Inverse of the transform; the linear part must not be singular
+    Transform GetInverse() const
+    {
+        const float cofactor[3][3] = {
+            { m[1][1] * m[2][2] - m[1][2] * m[2][1], m[0][2] * m[2][1] - m[0][1] * m[2][2], m[0][1] * m[1][2] - m[0][2] * m[1][1] },
+            { m[1][2] * m[2][0] - m[1][0] * m[2][2], m[0][0] * m[2][2] - m[0][2] * m[2][0], m[0][2] * m[1][0] - m[0][0] * m[1][2] },
+            { m[1][0] * m[2][1] - m[1][1] * m[2][0], m[0][1] * m[2][0] - m[0][0] * m[2][1], m[0][0] * m[1][1] - m[0][1] * m[1][0] } };
+        const float inv_det = 1.0f / (m[0][0] * cofactor[0][0] + m[0][1] * cofactor[1][0] + m[0][2] * cofactor[2][0]);
+
+        Transform t;
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                t.m[i][j] = cofactor[i][j] * inv_det;
+            }
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            t.m[i][3] = -(t.m[i][0] * m[0][3] + t.m[i][1] * m[1][3] + t.m[i][2] * m[2][3]);
+        }
+        return t;
+    }
+
+    Point3 ApplyToPoint(const Point3& p) const
+    {
+        return Point3(
+            m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+            m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+            m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+    }
+
+    Vector3 ApplyToVector(const Vector3& v) const
+    {
+        return Vector3(
+            m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+            m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+            m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+    }
+
+    // Multiplies by the transposed linear part. On an inverse transform this
+    // maps normals from the original space, which ApplyToVector would skew.
+    Vector3 ApplyTransposeToVector(const Vector3& v) const
+    {
+        return Vector3(
+            m[0][0] * v.x + m[1][0] * v.y + m[2][0] * v.z,
+            m[0][1] * v.x + m[1][1] * v.y + m[2][1] * v.z,
+            m[0][2] * v.x + m[1][2] * v.y + m[2][2] * v.z);
+    }
+
+private:
+    float m[3][4];
+};
@@ -1,6 +1,9 @@
 #pragma once
+#include <algorithm>
 #include <concepts>
 #include <array>
+#include <cmath>
+#include <ostream>
 #include "Utils.h"
 
 template <typename T> requires (std::same_as<T, float> || std::same_as<T, double>)
@@ -29,14 +32,11 @@ public:
 		return *this;
 	}
 
-	operator Vector3<float>() 
+	// A template, so Vector3<float> is not instantiated before a specialization can be declared
+	template <typename U>
+	operator Vector3<U>() const
 	{
-		return vector3<float>(float(x), float(y), float(z));
-	}
-
-	operator Vector3<double>()
-	{
-		return vector3<double>(double(x), double(y), double(z));
+		return Vector3<U>(U(x), U(y), U(z));
 	}
 
 	Vector3& operator/=(const float& a)
@@ -96,6 +96,11 @@ public:
 		return Vector3(x - a.x, y - a.y, z - a.z);
 	}
 
+	T operator[](int axis) const
+	{
+		return axis == 0 ? x : (axis == 1 ? y : z);
+	}
+
 	static float Dot(const Vector3& a, const Vector3& b)
 	{
 		return a.x * b.x + a.y * b.y + a.z * b.z;
@@ -118,7 +123,13 @@ public:
 
 	Vector3 GetNormalized() const
 	{
-		return Vector3(x / GetLength(), y / GetLength(), z / GetLength());
+#if defined(RT_FAST_MATH)
+		const T inv_length = inverse_sqrt(GetSquaredLength());
+		return Vector3(x * inv_length, y * inv_length, z * inv_length);
+#else
+		const T length = GetLength();
+		return Vector3(x / length, y / length, z / length);
+#endif
 	}
 
 	static Vector3 Random()
@@ -148,7 +159,7 @@ public:
 	{
 		auto a = random_float(0, 2 * pi);
 		auto z = random_float(-1, 1);
-		auto r = sqrt(1 - z * z);
+		const auto r = std::sqrt(kernel_real(1 - z * z));
 
 		return Vector3{ r * std::cos(a), r * std::sin(a), z };
 	}
@@ -189,33 +200,33 @@ public:
 	{
 		float cos_theta = Dot(-uv, n);
 		Vector3 r_out_parallel = etai_over_etat * (uv + cos_theta * n);
-		Vector3 r_out_perp = -sqrt(1.0 - r_out_parallel.GetSquaredLength()) * n;
+		Vector3 r_out_perp = -std::sqrt(kernel_real(1) - r_out_parallel.GetSquaredLength()) * n;
 
 		return r_out_parallel + r_out_perp;
 	}
 
 	static void NormalizeAndOutput(T r, T g, T b, std::ostream& out, int samples_per_pixel)
 	{
-		const auto scale = 1.0 / samples_per_pixel;
-		const auto R = sqrt(scale * r);
-		const auto G = sqrt(scale * g);
-		const auto B = sqrt(scale * b);
-
-		out << static_cast<int>(256 * std::clamp(R, 0.0, 0.999)) << ' '
-			<< static_cast<int>(256 * std::clamp(G, 0.0, 0.999)) << ' '
-			<< static_cast<int>(256 * std::clamp(B, 0.0, 0.999)) << '\n';
+		const auto scale = kernel_real(1) / samples_per_pixel;
+		const auto R = std::sqrt(scale * r);
+		const auto G = std::sqrt(scale * g);
+		const auto B = std::sqrt(scale * b);
+
+		out << static_cast<int>(256 * std::clamp(R, kernel_real(0), kernel_real(0.999))) << ' '
+			<< static_cast<int>(256 * std::clamp(G, kernel_real(0), kernel_real(0.999))) << ' '
+			<< static_cast<int>(256 * std::clamp(B, kernel_real(0), kernel_real(0.999))) << '\n';
 	}
 
 	void OutputValues(std::ostream& out, int samples_per_pixel) const
 	{
-		const auto scale = 1.0 / samples_per_pixel;
-		const auto R = sqrt(scale * r);
-		const auto G = sqrt(scale * g);
-		const auto B = sqrt(scale * b);
-
-		out << static_cast<int>(256 * std::clamp(R, 0.0, 0.999)) << ' '
-			<< static_cast<int>(256 * std::clamp(G, 0.0, 0.999)) << ' '
-			<< static_cast<int>(256 * std::clamp(B, 0.0, 0.999)) << '\n';
+		const auto scale = kernel_real(1) / samples_per_pixel;
+		const auto R = std::sqrt(scale * r);
+		const auto G = std::sqrt(scale * g);
+		const auto B = std::sqrt(scale * b);
+
+		out << static_cast<int>(256 * std::clamp(R, kernel_real(0), kernel_real(0.999))) << ' '
+			<< static_cast<int>(256 * std::clamp(G, kernel_real(0), kernel_real(0.999))) << ' '
+			<< static_cast<int>(256 * std::clamp(B, kernel_real(0), kernel_real(0.999))) << '\n';
 	}
 };
 
@@ -231,6 +242,11 @@ Vector3<T> operator*(const Vector3<T>& f, const Vector3<T>& v)
 	return Vector3(f.x * v.x, f.y * v.y, f.z * v.z);
 }
 
+// Building with RT_SIMD_VECTOR swaps Vector3<float> for a padded SSE version
+#if defined(RT_SIMD_VECTOR) && (defined(_M_X64) || defined(__SSE__))
+#include "VectorSimd.h"
+#endif
+
 #define Point3 Vector3
 #define ColorRGB Vector3
 
@@ -0,0 +1,250 @@
+#pragma once
+
+// SSE specialization of Vector3<float>, selected by building with
+// RT_SIMD_VECTOR. Included from Vector.h; do not include directly.
+//
+// The vector lives in one padded __m128 with w kept at zero, so a Vector3 is
+// 16 bytes and 16-byte aligned. Every operation rounds the same way as the
+// scalar template, in the same order (sums run x + y, then + z), so images
+// match the scalar build bit for bit as long as the compiler does not fuse
+// multiply-adds in the scalar code.
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <xmmintrin.h>
+
+template <>
+class Vector3<float>
+{
+public:
+	union
+	{
+		__m128 v;
+		struct { float x, y, z, w; };
+		struct { float r, g, b; };
+	};
+
+	Vector3() = default;
+
+	Vector3(float _x, float _y, float _z) : v(_mm_setr_ps(_x, _y, _z, 0.0f))
+	{
+	}
+
+	explicit Vector3(__m128 _v) : v(_v)
+	{
+	}
+
+	Vector3(const Vector3& arg) : v(arg.v)
+	{
+	}
+
+	Vector3& operator=(const Vector3& arg)
+	{
+		v = arg.v;
+		return *this;
+	}
+
+	template <typename U>
+	operator Vector3<U>() const
+	{
+		return Vector3<U>(U(x), U(y), U(z));
+	}
+
+	Vector3& operator/=(const float& s)
+	{
+		v = _mm_div_ps(v, _mm_set1_ps(s));
+		return *this;
+	}
+
+	Vector3& operator*=(const float& s)
+	{
+		v = _mm_mul_ps(v, _mm_set1_ps(s));
+		return *this;
+	}
+
+	Vector3 operator*(const float& s) const
+	{
+		return Vector3(_mm_mul_ps(v, _mm_set1_ps(s)));
+	}
+
+	Vector3 operator/(const float& s) const
+	{
+		return Vector3(_mm_div_ps(v, _mm_set1_ps(s)));
+	}
+
+	Vector3& operator+=(const Vector3& arg)
+	{
+		v = _mm_add_ps(v, arg.v);
+		return *this;
+	}
+
+	Vector3& operator-=(const Vector3& arg)
+	{
+		v = _mm_sub_ps(v, arg.v);
+		return *this;
+	}
+
+	Vector3 operator+(const Vector3& arg) const
+	{
+		return Vector3(_mm_add_ps(v, arg.v));
+	}
+
+	Vector3 operator-() const
+	{
+		// Flip the sign bits rather than subtract from zero, so -0 stays like the scalar version
+		return Vector3(_mm_xor_ps(v, _mm_set1_ps(-0.0f)));
+	}
+
+	Vector3 operator-(const Vector3& arg) const
+	{
+		return Vector3(_mm_sub_ps(v, arg.v));
+	}
+
+	float operator[](int axis) const
+	{
+		return axis == 0 ? x : (axis == 1 ? y : z);
+	}
+
+	static float Dot(const Vector3& a, const Vector3& b)
+	{
+		return SumXYZ(_mm_mul_ps(a.v, b.v));
+	}
+
+	static Vector3 Cross(const Vector3& a, const Vector3& b)
+	{
+		const __m128 a_yzx = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 b_yzx = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 a_zxy = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 1, 0, 2));
+		const __m128 b_zxy = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 1, 0, 2));
+		return Vector3(_mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx)));
+	}
+
+	float GetSquaredLength() const
+	{
+		return SumXYZ(_mm_mul_ps(v, v));
+	}
+
+	float GetLength() const
+	{
+		return std::sqrt(GetSquaredLength());
+	}
+
+	Vector3 GetNormalized() const
+	{
+#if defined(RT_FAST_MATH)
+		return Vector3(_mm_mul_ps(v, _mm_set1_ps(inverse_sqrt(GetSquaredLength()))));
+#else
+		return Vector3(_mm_div_ps(v, _mm_set1_ps(GetLength())));
+#endif
+	}
+
+	static Vector3 Random()
+	{
+		return Vector3(random_float(), random_float(), random_float());
+	}
+
+	static Vector3 Random(float min, float max)
+	{
+		return Vector3(random_float(min, max), random_float(min, max), random_float(min, max));
+	}
+
+	static Vector3 RandomInUnitSphere()
+	{
+		while (true)
+		{
+			auto p = Vector3::Random(-1.0f, 1.0f);
+			if (p.GetSquaredLength() >= 1)
+			{
+				continue;
+			}
+			return p;
+		}
+	}
+
+	static Vector3 RandomUnitVector()
+	{
+		auto a = random_float(0, 2 * pi);
+		auto z = random_float(-1, 1);
+		const auto r = std::sqrt(kernel_real(1 - z * z));
+
+		return Vector3(float(r * std::cos(a)), float(r * std::sin(a)), z);
+	}
+
+	static Vector3 RandomInHemiSphere(const Vector3& normal)
+	{
+		const Vector3 in_unit_Sphere = RandomInUnitSphere();
+
+		if (Dot(in_unit_Sphere, normal) > 0.0)
+		{
+			return in_unit_Sphere;
+		}
+		else
+		{
+			return -in_unit_Sphere;
+		}
+	}
+
+	static Vector3 RandomInUnitDisk()
+	{
+		while (true)
+		{
+			auto p = Vector3{ random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), 0 };
+			if (p.GetSquaredLength() >= 1)
+			{
+				continue;
+			}
+			return p;
+		}
+	}
+
+	static Vector3 Reflect(const Vector3& v, const Vector3& n)
+	{
+		return v - n * (2 * Dot(v, n));
+	}
+
+	static Vector3 Refract(const Vector3& uv, const Vector3& n, float etai_over_etat)
+	{
+		float cos_theta = Dot(-uv, n);
+		Vector3 r_out_parallel = (uv + n * cos_theta) * etai_over_etat;
+		Vector3 r_out_perp = n * float(-std::sqrt(kernel_real(1) - r_out_parallel.GetSquaredLength()));
+
+		return r_out_parallel + r_out_perp;
+	}
+
+	static void NormalizeAndOutput(float r, float g, float b, std::ostream& out, int samples_per_pixel)
+	{
+		Vector3<float>(r, g, b).OutputValues(out, samples_per_pixel);
+	}
+
+	void OutputValues(std::ostream& out, int samples_per_pixel) const
+	{
+		const auto scale = kernel_real(1) / samples_per_pixel;
+		const auto R = std::sqrt(scale * r);
+		const auto G = std::sqrt(scale * g);
+		const auto B = std::sqrt(scale * b);
+
+		out << static_cast<int>(256 * std::clamp(R, kernel_real(0), kernel_real(0.999))) << ' '
+			<< static_cast<int>(256 * std::clamp(G, kernel_real(0), kernel_real(0.999))) << ' '
+			<< static_cast<int>(256 * std::clamp(B, kernel_real(0), kernel_real(0.999))) << '\n';
+	}
+
+private:
+	// (x + y) + z, ignoring w
+	static float SumXYZ(__m128 m)
+	{
+		const __m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+		const __m128 z = _mm_movehl_ps(m, m);
+		return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+	}
+};
+
+inline Vector3<float> operator*(const float& f, const Vector3<float>& v)
+{
+	return v * f;
+}
+
+inline Vector3<float> operator*(const Vector3<float>& f, const Vector3<float>& v)
+{
+	return Vector3<float>(_mm_mul_ps(f.v, v.v));
+}